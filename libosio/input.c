@@ -0,0 +1,199 @@
+#define _GNU_SOURCE
+
+#include "input.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define STREAM_BUF_SIZE (1 << 18)   // начальный блок потокового чтения
+#define MAP_MIN_SIZE    (1 << 16)   // мелкие файлы дешевле прочитать read()
+
+static int try_map(Input *in, const struct stat *st) {
+    off_t pos = lseek(in->fd, 0, SEEK_CUR);
+    if (pos < 0 || st->st_size - pos < MAP_MIN_SIZE) return -1;
+
+    // смещение mmap обязано быть кратным странице
+    long page = sysconf(_SC_PAGESIZE);
+    off_t base = pos - pos % page;
+    size_t len = (size_t)(st->st_size - base);
+
+    void *m = mmap(NULL, len, PROT_READ, MAP_PRIVATE, in->fd, base);
+    if (m == MAP_FAILED) return -1;
+
+    madvise(m, len, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    madvise(m, len, MADV_HUGEPAGE);   // не везде поддерживается для файлов — не критично
+#endif
+
+    in->mapped = true;
+    in->map = m;
+    in->map_len = len;
+    in->data_off = (size_t)(pos - base);
+    in->data_end = len;
+    in->end_off = st->st_size;
+    return 0;
+}
+
+int input_open(Input *in, int fd) {
+    memset(in, 0, sizeof(*in));
+    in->fd = fd;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && try_map(in, &st) == 0) {
+        return 0;
+    }
+
+    in->cap = STREAM_BUF_SIZE;
+    in->buf = malloc(in->cap);
+    if (!in->buf) {
+        errno = ENOMEM;
+        return -1;
+    }
+    return 0;
+}
+
+void input_close(Input *in) {
+    if (in->mapped) {
+        if (in->map) munmap(in->map, in->map_len);
+        // как после чтения до конца: позиция дескриптора — в конце файла
+        if (in->end_off >= 0) lseek(in->fd, in->end_off, SEEK_SET);
+    }
+    free(in->buf);
+    memset(in, 0, sizeof(*in));
+    in->fd = -1;
+}
+
+int input_open_range(Input *in, int fd, off_t start, off_t end, char delim) {
+    memset(in, 0, sizeof(*in));
+    in->fd = fd;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) return -1;
+    if (end > st.st_size) end = st.st_size;
+    in->mapped = true;
+    in->end_off = -1;
+    if (start >= end) return 0;   // пустой кусок
+
+    // байт перед start нужен, чтобы понять, начинается ли там запись
+    long page = sysconf(_SC_PAGESIZE);
+    off_t first = start > 0 ? start - 1 : 0;
+    off_t base = first - first % page;
+    size_t len = (size_t)(st.st_size - base);
+
+    void *m = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, base);
+    if (m == MAP_FAILED) return -1;
+    in->map = m;
+    in->map_len = len;
+
+    const char *lo = in->map + (start - base);
+    const char *hi = in->map + (end - base);
+    const char *stop = in->map + len;
+
+    // запись, начатая в предыдущем куске, принадлежит ему
+    if (start > 0 && lo[-1] != delim) {
+        const char *d = memchr(lo, delim, (size_t)(stop - lo));
+        lo = d ? d + 1 : stop;
+    }
+    // последнюю запись дочитываем за пределы куска
+    if (hi < stop && hi[-1] != delim) {
+        const char *d = memchr(hi, delim, (size_t)(stop - hi));
+        hi = d ? d + 1 : stop;
+    }
+    if (lo > hi) lo = hi;
+
+    in->data_off = (size_t)(lo - in->map);
+    in->data_end = (size_t)(hi - in->map);
+    madvise(in->map + in->data_off, in->data_end - in->data_off, MADV_SEQUENTIAL);
+    return 0;
+}
+
+static int next_mapped(Input *in, const char **p, size_t *n) {
+    if (in->data_off >= in->data_end) return 0;
+    *p = in->map + in->data_off;
+    *n = in->data_end - in->data_off;
+    in->data_off = in->data_end;
+    return 1;
+}
+
+// Дочитывает в buf[len..cap). >0 — прочитано, 0 — EOF, -1 — ошибка
+static ssize_t fill(Input *in) {
+    for (;;) {
+        ssize_t r = read(in->fd, in->buf + in->len, in->cap - in->len);
+        if (r < 0 && errno == EINTR) continue;
+        if (r == 0) in->eof = true;
+        if (r > 0) in->len += (size_t)r;
+        return r;
+    }
+}
+
+int input_next(Input *in, const char **p, size_t *n) {
+    if (in->mapped) return next_mapped(in, p, n);
+    if (in->eof) return 0;
+
+    in->len = in->start = 0;
+    ssize_t r = fill(in);
+    if (r <= 0) return (int)r;
+    *p = in->buf;
+    *n = in->len;
+    return 1;
+}
+
+int input_next_records(Input *in, char delim, const char **p, size_t *n) {
+    // отображение заканчивается концом файла, значит, целиком состоит из записей
+    if (in->mapped) return next_mapped(in, p, n);
+
+    // хвост прошлого блока (неполная запись) и то, что просили оставить
+    // (input_keep), — в начало буфера
+    size_t from = in->start - in->keep;
+    if (from > 0) {
+        memmove(in->buf, in->buf + from, in->len - from);
+        in->len -= from;
+    }
+    in->kept = in->keep;
+    in->start = in->keep = 0;
+
+    for (;;) {
+        if (in->eof) {
+            if (in->len == in->kept) return 0;
+            *p = in->buf + in->kept;
+            *n = in->len - in->kept;
+            in->start = in->len;
+            return 1;
+        }
+
+        // запись длиннее буфера (или буфер занят сохранёнными строками) — растим
+        if (in->len == in->cap || in->kept > in->cap / 2) {
+            size_t new_cap = in->cap * 2;
+            char *tmp = realloc(in->buf, new_cap);
+            if (!tmp) {
+                errno = ENOMEM;
+                return -1;
+            }
+            in->buf = tmp;
+            in->cap = new_cap;
+        }
+
+        size_t scan_from = in->len;
+        ssize_t r = fill(in);
+        if (r < 0) return -1;
+        if (r == 0) continue;
+
+        const char *last = memrchr(in->buf + scan_from, delim, (size_t)r);
+        if (last) {
+            in->start = (size_t)(last - in->buf) + 1;
+            *p = in->buf + in->kept;
+            *n = in->start - in->kept;
+            return 1;
+        }
+    }
+}
+
+void input_keep(Input *in, const char *p) {
+    if (in->mapped || p < in->buf || p > in->buf + in->start) return;
+    in->keep = (size_t)(in->buf + in->start - p);
+}
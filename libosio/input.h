@@ -0,0 +1,56 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// Общий источник входных данных для mycat и mygrep.
+// Обычные файлы отображаются в память целиком и читаются на месте,
+// pipe/tty/stdin и всё, что не удалось отобразить, читаются блоками.
+typedef struct {
+    int fd;
+    bool mapped;
+    bool eof;
+
+    // режим mmap
+    char *map;          // начало отображения (выровнено на страницу)
+    size_t map_len;
+    size_t data_off;    // смещение первого непрочитанного байта внутри map
+    size_t data_end;    // конец данных внутри map
+    off_t end_off;      // куда поставить позицию fd при закрытии (-1 — не трогать)
+
+    // потоковый режим
+    char *buf;
+    size_t cap;
+    size_t len;         // валидные байты в buf
+    size_t start;       // начало непереданного хвоста в buf
+    size_t keep;        // сколько байт перед start сохранить при следующем чтении
+    size_t kept;        // сколько байт прошлого блока лежит прямо перед текущим
+} Input;
+
+// 0 — готово, -1 — ошибка (errno выставлен)
+int input_open(Input *in, int fd);
+void input_close(Input *in);
+
+// Только записи, начинающиеся в [start, end) обычного файла: начало
+// сдвигается за ближайший разделитель, конец продлевается до конца
+// последней записи. Так соседние куски файла делят его без пересечений.
+// Позиция fd не используется и не меняется.
+int input_open_range(Input *in, int fd, off_t start, off_t end, char delim);
+
+// Очередной кусок данных без учёта строк.
+// 1 — есть данные, 0 — EOF, -1 — ошибка чтения
+int input_next(Input *in, const char **p, size_t *n);
+
+// Очередной блок целых записей: заканчивается на delim, кроме, возможно,
+// последнего блока файла. Неполная запись переносится в следующий блок.
+// Коды возврата как у input_next.
+int input_next_records(Input *in, char delim, const char **p, size_t *n);
+
+// Следующий input_next_records оставит байты последнего блока начиная с p
+// прямо перед новым блоком (их число — в kept): так mygrep -B видит
+// предыдущие строки, не копируя их. В режиме mmap блок один и это не нужно.
+void input_keep(Input *in, const char *p);
+
+#endif
@@ -0,0 +1,168 @@
+#define _GNU_SOURCE
+
+#include "osio.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+
+#define COPY_BUF_SIZE   (1 << 20)   // 1 MiB на read/write
+#define COPY_CHUNK      (1 << 30)   // сколько просим у ядра за один zero-copy вызов
+#define PIPE_BUF_SIZE   (1 << 20)   // желаемый размер буфера выходного pipe
+
+int write_full(int fd, const void *buf, size_t count) {
+    const char *p = (const char *)buf;
+    size_t left = count;
+    while (left > 0) {
+        ssize_t n = write(fd, p, left);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) {
+            errno = EIO;
+            return -1;
+        }
+        p += (size_t)n;
+        left -= (size_t)n;
+    }
+    return 0;
+}
+
+int writev_full(int fd, struct iovec *iov, int iovcnt) {
+    while (iovcnt > 0) {
+        ssize_t n = writev(fd, iov, iovcnt);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) {
+            errno = EIO;
+            return -1;
+        }
+        // пропускаем записанные куски, недописанный сдвигаем
+        size_t done = (size_t)n;
+        while (iovcnt > 0 && done >= iov->iov_len) {
+            done -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + done;
+            iov->iov_len -= done;
+        }
+    }
+    return 0;
+}
+
+ssize_t read_full(int fd, void *buf, size_t count) {
+    char *p = (char *)buf;
+    size_t got = 0;
+    while (got < count) {
+        ssize_t n = read(fd, p + got, count - got);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) break;
+        got += (size_t)n;
+    }
+    return (ssize_t)got;
+}
+
+// Ошибки, при которых zero-copy вызов просто не поддерживается для
+// данной пары дескрипторов — тогда переходим к следующему способу.
+static bool copy_unsupported(int err) {
+    return err == EINVAL || err == ENOSYS || err == EXDEV ||
+           err == EOPNOTSUPP || err == EBADF || err == EPERM;
+}
+
+typedef ssize_t (*copy_step_fn)(int in_fd, int out_fd, size_t max);
+
+static ssize_t step_copy_file_range(int in_fd, int out_fd, size_t max) {
+    return copy_file_range(in_fd, NULL, out_fd, NULL, max, 0);
+}
+
+static ssize_t step_sendfile(int in_fd, int out_fd, size_t max) {
+    return sendfile(out_fd, in_fd, NULL, max);
+}
+
+static ssize_t step_splice(int in_fd, int out_fd, size_t max) {
+    if (max > PIPE_BUF_SIZE) max = PIPE_BUF_SIZE;
+    return splice(in_fd, NULL, out_fd, NULL, max, SPLICE_F_MOVE | SPLICE_F_MORE);
+}
+
+// Гоняет один zero-copy способ, пока не скопировано *left байт или не EOF.
+// 0  — готово (EOF, если *left > 0)
+// 1  — способ не подходит, продолжаем следующим (позиция в файле корректна)
+// -1 — настоящая ошибка (errno выставлен)
+static int copy_with(copy_step_fn step, int in_fd, int out_fd, uint64_t *left) {
+    while (*left > 0) {
+        ssize_t n = step(in_fd, out_fd, *left < COPY_CHUNK ? (size_t)*left : COPY_CHUNK);
+        if (n > 0) {
+            *left -= (uint64_t)n;
+            continue;
+        }
+        if (n == 0) return 0;
+        if (errno == EINTR) continue;
+        return copy_unsupported(errno) ? 1 : -1;
+    }
+    return 0;
+}
+
+// Сначала копирование внутри ядра, затем большие блоки read/write.
+// Буфер запасного пути живёт до конца потока.
+static int copy_core(int in_fd, int out_fd, uint64_t *left, bool *read_failed) {
+    struct stat in_st, out_st;
+    bool in_ok = fstat(in_fd, &in_st) == 0;
+    bool out_ok = fstat(out_fd, &out_st) == 0;
+
+    *read_failed = false;
+
+    if (in_ok && out_ok) {
+        int r = 1;
+        if (S_ISREG(out_st.st_mode) && S_ISREG(in_st.st_mode)) {
+            r = copy_with(step_copy_file_range, in_fd, out_fd, left);
+            if (r == 1) r = copy_with(step_sendfile, in_fd, out_fd, left);
+        } else if (S_ISFIFO(out_st.st_mode)) {
+            fcntl(out_fd, F_SETPIPE_SZ, PIPE_BUF_SIZE); // не критично, если не вышло
+            r = copy_with(step_splice, in_fd, out_fd, left);
+            if (r == 1 && S_ISREG(in_st.st_mode)) r = copy_with(step_sendfile, in_fd, out_fd, left);
+        }
+        if (r != 1) return r;
+        if (S_ISREG(in_st.st_mode)) posix_fadvise(in_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    static _Thread_local char *buf = NULL;
+    if (!buf) {
+        buf = malloc(COPY_BUF_SIZE);
+        if (!buf) return -1;
+    }
+
+    while (*left > 0) {
+        ssize_t n = read(in_fd, buf, *left < COPY_BUF_SIZE ? (size_t)*left : COPY_BUF_SIZE);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            *read_failed = true;
+            return -1;
+        }
+        if (n == 0) return 0;
+        if (write_full(out_fd, buf, (size_t)n) < 0) return -1;
+        *left -= (uint64_t)n;
+    }
+    return 0;
+}
+
+int copy_fd(int in_fd, int out_fd, bool *read_failed) {
+    uint64_t left = UINT64_MAX;
+    return copy_core(in_fd, out_fd, &left, read_failed);
+}
+
+int copy_range(int in_fd, int out_fd, uint64_t len, bool *read_failed) {
+    uint64_t left = len;
+    if (copy_core(in_fd, out_fd, &left, read_failed) < 0) return -1;
+    return left > 0 ? 1 : 0;
+}
@@ -0,0 +1,33 @@
+#ifndef OSIO_H
+#define OSIO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// Общие примитивы ввода-вывода утилит практических работ: полные чтение
+// и запись с повтором при EINTR и копирование между дескрипторами.
+// Копирование идёт внутри ядра (copy_file_range, sendfile, splice), а если
+// для пары дескрипторов это не поддерживается — большими блоками read/write.
+
+// 0 — записано всё, -1 — ошибка (errno выставлен)
+int write_full(int fd, const void *buf, size_t count);
+
+// Как write_full для нескольких кусков одним writev; iov портится
+int writev_full(int fd, struct iovec *iov, int iovcnt);
+
+// Читает, пока не наберётся count байт или не наступит EOF.
+// Число прочитанных байт (меньше count — только на EOF) или -1
+ssize_t read_full(int fd, void *buf, size_t count);
+
+// in_fd -> out_fd с текущих позиций до EOF. 0 или -1; *read_failed
+// отличает ошибку чтения от ошибки записи
+int copy_fd(int in_fd, int out_fd, bool *read_failed);
+
+// Ровно len байт in_fd -> out_fd с текущих позиций.
+// 0 — готово, 1 — EOF раньше len байт, -1 — ошибка (как у copy_fd)
+int copy_range(int in_fd, int out_fd, uint64_t len, bool *read_failed);
+
+#endif
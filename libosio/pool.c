@@ -0,0 +1,218 @@
+#include "pool.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+typedef struct {
+    pthread_mutex_t mu;
+    size_t *tasks;          // кольцевой буфер
+    size_t head, len, cap;
+} Deque;
+
+struct Pool {
+    pool_fn fn;
+    void *ctx;
+
+    int n_threads;          // число очередей
+    int n_started;          // сколько потоков реально запущено
+    pthread_t *threads;
+    Deque *deques;
+
+    pthread_mutex_t mu;     // защищает pending/stop и ожидание работы
+    pthread_cond_t work_cv;
+    pthread_cond_t idle_cv;
+    size_t pending;         // поставлено и ещё не выполнено
+    size_t queued;          // лежит в очередях (подсказка для спящих)
+    unsigned next_rr;       // куда класть задачи извне пула
+    bool stop;
+};
+
+typedef struct {
+    Pool *pool;
+    int id;
+} WorkerArg;
+
+static _Thread_local Pool *tls_pool = NULL;
+static _Thread_local int tls_id = -1;
+
+static bool deque_push_tail(Deque *d, size_t task) {
+    pthread_mutex_lock(&d->mu);
+    if (d->len == d->cap) {
+        size_t new_cap = d->cap ? d->cap * 2 : 64;
+        size_t *t = malloc(new_cap * sizeof(size_t));
+        if (!t) {
+            pthread_mutex_unlock(&d->mu);
+            return false;
+        }
+        for (size_t i = 0; i < d->len; ++i) t[i] = d->tasks[(d->head + i) % d->cap];
+        free(d->tasks);
+        d->tasks = t;
+        d->head = 0;
+        d->cap = new_cap;
+    }
+    d->tasks[(d->head + d->len) % d->cap] = task;
+    d->len++;
+    pthread_mutex_unlock(&d->mu);
+    return true;
+}
+
+static bool deque_pop_head(Deque *d, size_t *task) {
+    pthread_mutex_lock(&d->mu);
+    bool ok = d->len > 0;
+    if (ok) {
+        *task = d->tasks[d->head];
+        d->head = (d->head + 1) % d->cap;
+        d->len--;
+    }
+    pthread_mutex_unlock(&d->mu);
+    return ok;
+}
+
+static bool deque_steal_tail(Deque *d, size_t *task) {
+    pthread_mutex_lock(&d->mu);
+    bool ok = d->len > 0;
+    if (ok) {
+        d->len--;
+        *task = d->tasks[(d->head + d->len) % d->cap];
+    }
+    pthread_mutex_unlock(&d->mu);
+    return ok;
+}
+
+static bool take_task(Pool *p, int id, size_t *task) {
+    if (deque_pop_head(&p->deques[id], task)) return true;
+    for (int k = 1; k < p->n_threads; ++k) {
+        if (deque_steal_tail(&p->deques[(id + k) % p->n_threads], task)) return true;
+    }
+    return false;
+}
+
+static void *worker_main(void *arg) {
+    WorkerArg *wa = arg;
+    Pool *p = wa->pool;
+    int id = wa->id;
+    free(wa);
+    tls_pool = p;
+    tls_id = id;
+
+    for (;;) {
+        size_t task;
+        if (take_task(p, id, &task)) {
+            pthread_mutex_lock(&p->mu);
+            p->queued--;
+            pthread_mutex_unlock(&p->mu);
+
+            p->fn(p->ctx, task);
+
+            pthread_mutex_lock(&p->mu);
+            if (--p->pending == 0) pthread_cond_broadcast(&p->idle_cv);
+            pthread_mutex_unlock(&p->mu);
+            continue;
+        }
+
+        pthread_mutex_lock(&p->mu);
+        while (!p->stop && p->queued == 0) pthread_cond_wait(&p->work_cv, &p->mu);
+        bool stop = p->stop && p->queued == 0;
+        pthread_mutex_unlock(&p->mu);
+        if (stop) break;
+    }
+    return NULL;
+}
+
+Pool *pool_create(int n_threads, pool_fn fn, void *ctx) {
+    if (n_threads < 1) n_threads = 1;
+
+    Pool *p = calloc(1, sizeof(*p));
+    if (!p) return NULL;
+    p->fn = fn;
+    p->ctx = ctx;
+    p->n_threads = n_threads;
+    p->threads = calloc((size_t)n_threads, sizeof(pthread_t));
+    p->deques = calloc((size_t)n_threads, sizeof(Deque));
+    if (!p->threads || !p->deques) {
+        free(p->threads);
+        free(p->deques);
+        free(p);
+        return NULL;
+    }
+    pthread_mutex_init(&p->mu, NULL);
+    pthread_cond_init(&p->work_cv, NULL);
+    pthread_cond_init(&p->idle_cv, NULL);
+    for (int i = 0; i < n_threads; ++i) pthread_mutex_init(&p->deques[i].mu, NULL);
+
+    // Очередей всегда n_threads; если часть потоков не стартовала,
+    // их задачи просто украдут остальные.
+    for (; p->n_started < n_threads; ++p->n_started) {
+        WorkerArg *wa = malloc(sizeof(*wa));
+        if (!wa) break;
+        wa->pool = p;
+        wa->id = p->n_started;
+        if (pthread_create(&p->threads[p->n_started], NULL, worker_main, wa) != 0) {
+            free(wa);
+            break;
+        }
+    }
+    if (p->n_started == 0) {
+        pool_destroy(p);
+        return NULL;
+    }
+    return p;
+}
+
+void pool_submit(Pool *p, size_t task) {
+    int id;
+    if (tls_pool == p) {
+        id = tls_id;
+    } else {
+        pthread_mutex_lock(&p->mu);
+        id = (int)(p->next_rr++ % (unsigned)p->n_threads);
+        pthread_mutex_unlock(&p->mu);
+    }
+
+    pthread_mutex_lock(&p->mu);
+    p->pending++;
+    p->queued++;
+    pthread_mutex_unlock(&p->mu);
+
+    if (!deque_push_tail(&p->deques[id], task)) {
+        // очередь не выросла — выполняем на месте
+        pthread_mutex_lock(&p->mu);
+        p->queued--;
+        pthread_mutex_unlock(&p->mu);
+        p->fn(p->ctx, task);
+        pthread_mutex_lock(&p->mu);
+        if (--p->pending == 0) pthread_cond_broadcast(&p->idle_cv);
+        pthread_mutex_unlock(&p->mu);
+        return;
+    }
+
+    pthread_mutex_lock(&p->mu);
+    pthread_cond_signal(&p->work_cv);
+    pthread_mutex_unlock(&p->mu);
+}
+
+void pool_wait(Pool *p) {
+    pthread_mutex_lock(&p->mu);
+    while (p->pending > 0) pthread_cond_wait(&p->idle_cv, &p->mu);
+    pthread_mutex_unlock(&p->mu);
+}
+
+void pool_destroy(Pool *p) {
+    pthread_mutex_lock(&p->mu);
+    p->stop = true;
+    pthread_cond_broadcast(&p->work_cv);
+    pthread_mutex_unlock(&p->mu);
+    for (int i = 0; i < p->n_started; ++i) pthread_join(p->threads[i], NULL);
+
+    for (int i = 0; i < p->n_threads; ++i) {
+        pthread_mutex_destroy(&p->deques[i].mu);
+        free(p->deques[i].tasks);
+    }
+    pthread_mutex_destroy(&p->mu);
+    pthread_cond_destroy(&p->work_cv);
+    pthread_cond_destroy(&p->idle_cv);
+    free(p->deques);
+    free(p->threads);
+    free(p);
+}
@@ -0,0 +1,25 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+// Пул потоков с перехватом работы (work stealing). У каждого потока своя
+// очередь задач: хозяин берёт самые старые задачи с головы, а простаивающий
+// поток ворует самые новые с хвоста чужой очереди. Задача — просто номер,
+// смысл ему придаёт fn.
+typedef struct Pool Pool;
+
+typedef void (*pool_fn)(void *ctx, size_t task);
+
+// NULL — не удалось создать ни одного потока
+Pool *pool_create(int n_threads, pool_fn fn, void *ctx);
+
+// Можно вызывать из любого потока; из рабочего — задача ложится в его очередь
+void pool_submit(Pool *p, size_t task);
+
+// Ждёт, пока не будут выполнены все поставленные задачи
+void pool_wait(Pool *p);
+
+void pool_destroy(Pool *p);
+
+#endif
@@ -0,0 +1,126 @@
+#define _GNU_SOURCE
+
+#include "uring.h"
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+int ring_init(Ring *r, unsigned entries, unsigned features) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    memset(r, 0, sizeof(*r));
+
+    r->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (r->fd < 0) return -1;
+
+    unsigned need = IORING_FEAT_SINGLE_MMAP | features;
+    if ((p.features & need) != need) {
+        close(r->fd);
+        return -1;
+    }
+
+    r->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (r->cq_size > r->sq_size) r->sq_size = r->cq_size;
+
+    r->sq_ptr = mmap(NULL, r->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_ptr == MAP_FAILED) {
+        close(r->fd);
+        return -1;
+    }
+    r->cq_ptr = r->sq_ptr;
+
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        munmap(r->sq_ptr, r->sq_size);
+        close(r->fd);
+        return -1;
+    }
+
+    char *sq = r->sq_ptr;
+    r->sq_head  = (unsigned *)(sq + p.sq_off.head);
+    r->sq_tail  = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask  = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->cq_head  = (unsigned *)(sq + p.cq_off.head);
+    r->cq_tail  = (unsigned *)(sq + p.cq_off.tail);
+    r->cq_mask  = (unsigned *)(sq + p.cq_off.ring_mask);
+    r->cqes     = (struct io_uring_cqe *)(sq + p.cq_off.cqes);
+    r->entries  = p.sq_entries;
+    return 0;
+}
+
+void ring_free(Ring *r) {
+    munmap(r->sqes, r->sqes_size);
+    munmap(r->sq_ptr, r->sq_size);
+    close(r->fd);
+}
+
+struct io_uring_sqe *ring_sqe(Ring *r, uint64_t user_data) {
+    unsigned tail = *r->sq_tail;
+    unsigned idx = tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = user_data;
+    r->sq_array[idx] = idx;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    r->to_submit++;
+    r->inflight++;
+    return sqe;
+}
+
+static int ring_enter(Ring *r, unsigned min_complete) {
+    for (;;) {
+        long n = syscall(__NR_io_uring_enter, r->fd, r->to_submit, min_complete,
+                         min_complete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (n >= 0) {
+            r->to_submit -= (unsigned)n;
+            return 0;
+        }
+        if (errno != EINTR) return -1;
+    }
+}
+
+// Отдаёт в fn все готовые CQE; сколько их было
+static unsigned ring_reap(Ring *r, ring_cqe_fn fn, void *ctx) {
+    unsigned head = *r->cq_head;
+    unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+    unsigned n = tail - head;
+    for (; head != tail; ++head) {
+        struct io_uring_cqe cqe = r->cqes[head & *r->cq_mask];
+        r->inflight--;
+        fn(ctx, &cqe);
+    }
+    __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+    return n;
+}
+
+int ring_pump(Ring *r, ring_cqe_fn fn, void *ctx) {
+    if (ring_enter(r, 1) < 0) return -1;
+    ring_reap(r, fn, ctx);
+    return 0;
+}
+
+void ring_drain(Ring *r, ring_cqe_fn fn, void *ctx) {
+    // SQE, которые ядро ещё не забрало, убираем из очереди: их никто не выполнит
+    unsigned unseen = *r->sq_tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    __atomic_store_n(r->sq_tail, *r->sq_tail - unseen, __ATOMIC_RELEASE);
+    r->inflight -= unseen;
+    r->to_submit = 0;
+
+    while (r->inflight > 0) {
+        if (ring_reap(r, fn, ctx) > 0) continue;
+        // ждём в ядре, а если io_uring_enter отказывает и теперь — опрашиваем CQ
+        if (ring_enter(r, 1) < 0) {
+            struct timespec ts = { 0, 100 * 1000 };
+            nanosleep(&ts, NULL);
+        }
+    }
+}
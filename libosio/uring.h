@@ -0,0 +1,44 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/io_uring.h>
+
+// Минимальная обёртка над io_uring без liburing. Кольцо не
+// потокобезопасно: им пользуется один поток.
+typedef struct {
+    int fd;
+    unsigned entries;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ptr, *cq_ptr;
+    size_t sq_size, cq_size, sqes_size;
+    unsigned to_submit;
+    unsigned inflight;      // отправлено и ещё не завершено
+} Ring;
+
+// 0 — готово; -1 — io_uring недоступен или ядро без нужных features
+// (IORING_FEAT_*; общий mmap колец требуется всегда)
+int ring_init(Ring *r, unsigned entries, unsigned features);
+void ring_free(Ring *r);
+
+// Очередной SQE, обнулённый и с user_data. Вызывающий следит, чтобы
+// в полёте было не больше entries операций.
+struct io_uring_sqe *ring_sqe(Ring *r, uint64_t user_data);
+
+typedef void (*ring_cqe_fn)(void *ctx, const struct io_uring_cqe *cqe);
+
+// Отправляет накопленное, ждёт хотя бы одно завершение и отдаёт все
+// готовые CQE в fn (из fn можно ставить новые SQE). -1 — ошибка io_uring_enter.
+int ring_pump(Ring *r, ring_cqe_fn fn, void *ctx);
+
+// Дожидается всех операций, которые ядро уже забрало, и отдаёт их CQE в fn
+// (ставить новые SQE из fn нельзя); ещё не отправленные SQE отбрасываются.
+// Для отказа ring_pump: пока операции в полёте, ядро пишет в их буферы,
+// и ни переиспользовать их, ни закрыть кольцо раньше нельзя.
+void ring_drain(Ring *r, ring_cqe_fn fn, void *ctx);
+
+#endif
@@ -0,0 +1,125 @@
+#define _GNU_SOURCE
+
+#include "writer.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#include "osio.h"
+
+int writer_init(Writer *w, int fd, size_t cap) {
+    memset(w, 0, sizeof(*w));
+    w->fd = fd;
+    if (cap == 0 && fd < 0) return 0;
+    w->buf = malloc(cap);
+    if (!w->buf) {
+        errno = ENOMEM;
+        return -1;
+    }
+    w->cap = cap;
+    return 0;
+}
+
+static void writer_fail(Writer *w) {
+    if (!w->failed) w->err = errno;
+    w->failed = true;
+}
+
+// В памяти: места хотя бы под n байт сверх len
+static bool writer_grow(Writer *w, size_t n) {
+    if (w->failed) return false;
+    size_t need = w->len + n;
+    size_t new_cap = w->cap ? w->cap : 1 << 12;
+    while (new_cap < need) new_cap *= 2;
+    char *tmp = realloc(w->buf, new_cap);
+    if (!tmp) {
+        errno = ENOMEM;
+        writer_fail(w);
+        return false;
+    }
+    w->buf = tmp;
+    w->cap = new_cap;
+    return true;
+}
+
+void writer_flush(Writer *w) {
+    if (w->fd < 0) return;
+    if (w->len > 0 && !w->failed && write_full(w->fd, w->buf, w->len) < 0) writer_fail(w);
+    w->len = 0;
+}
+
+void writer_put(Writer *w, const void *p, size_t n) {
+    if (n == 0) return;     // пустой буфер в памяти может быть ещё NULL
+    if (n <= w->cap - w->len) {
+        memcpy(w->buf + w->len, p, n);
+        w->len += n;
+        return;
+    }
+    if (w->fd < 0) {
+        if (writer_grow(w, n)) {
+            memcpy(w->buf + w->len, p, n);
+            w->len += n;
+        }
+        return;
+    }
+    if (n < w->cap / 2) {
+        writer_flush(w);
+        memcpy(w->buf, p, n);
+        w->len = n;
+        return;
+    }
+    if (!w->failed) {
+        struct iovec iov[2] = {
+            { .iov_base = w->buf,      .iov_len = w->len },
+            { .iov_base = (void *)p,   .iov_len = n },
+        };
+        if (writev_full(w->fd, iov, 2) < 0) writer_fail(w);
+    }
+    w->len = 0;
+}
+
+char *writer_reserve(Writer *w, size_t n) {
+    if (n > w->cap - w->len) {
+        if (w->fd >= 0) writer_flush(w);
+        else if (!writer_grow(w, n)) return NULL;
+    }
+    return w->buf + w->len;
+}
+
+void writer_printf(Writer *w, const char *fmt, ...) {
+    // обычно хватает буфера на стеке; длинное форматируется второй раз в кучу
+    char tmp[1024];
+    va_list ap, ap2;
+    va_start(ap, fmt);
+    va_copy(ap2, ap);
+    int n = vsnprintf(tmp, sizeof(tmp), fmt, ap);
+    va_end(ap);
+    if (n >= 0 && (size_t)n < sizeof(tmp)) {
+        writer_put(w, tmp, (size_t)n);
+    } else if (n >= 0) {
+        char *big = malloc((size_t)n + 1);
+        if (!big) {
+            errno = ENOMEM;
+            writer_fail(w);
+        } else {
+            vsnprintf(big, (size_t)n + 1, fmt, ap2);
+            writer_put(w, big, (size_t)n);
+            free(big);
+        }
+    }
+    va_end(ap2);
+}
+
+void writer_commit(Writer *w, size_t n) {
+    w->len += n;
+}
+
+void writer_free(Writer *w) {
+    free(w->buf);
+    w->buf = NULL;
+    w->cap = w->len = 0;
+}
@@ -0,0 +1,37 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Буферизованный вывод в fd. Мелкие куски копятся в буфере, крупные
+// в буфер не копируются: уходят вместе с накопленным одним writev.
+// С fd == -1 — растущий буфер в памяти: ничего не пишется, всё выведенное
+// остаётся в buf[0..len) (так параллельные задачи копят результат, чтобы
+// потом выдать его по порядку). Первая ошибка записи (или нехватка памяти)
+// запоминается, дальнейший вывод отбрасывается.
+typedef struct {
+    int fd;
+    char *buf;
+    size_t cap, len;
+    bool failed;
+    int err;        // errno первой ошибки записи
+} Writer;
+
+// 0 — готово, -1 — не хватило памяти. Для fd == -1 cap — начальный размер,
+// 0 — выделить при первой записи
+int writer_init(Writer *w, int fd, size_t cap);
+void writer_put(Writer *w, const void *p, size_t n);
+// Форматированный вывод; длинные строки не обрезаются
+void writer_printf(Writer *w, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+// В памяти (fd == -1) ничего не делает
+void writer_flush(Writer *w);
+// Место под n байт (n <= cap) в конце буфера для записи напрямую;
+// записанное подтверждается writer_commit. В памяти буфер растёт,
+// NULL — не хватило памяти
+char *writer_reserve(Writer *w, size_t n);
+void writer_commit(Writer *w, size_t n);
+// Не сбрасывает буфер: сначала writer_flush
+void writer_free(Writer *w);
+
+#endif
@@ -0,0 +1,169 @@
+#include "acmatch.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define AC_NONE    UINT32_MAX
+#define AC_ACCEPT  0x80000000u      // флаг в переходе: целевое состояние допускающее
+#define AC_MAX_ROW 0x7fffffffu
+
+struct AcAutomaton {
+    uint16_t cls[256];      // байт -> класс
+    uint32_t nclasses;
+    uint32_t nstates;
+    // delta[state * nclasses + class] = target * nclasses (смещение строки) | AC_ACCEPT
+    uint32_t *delta;
+    uint32_t *out_len;      // длина образца, заканчивающегося в состоянии (0 — нет)
+    bool match_empty;       // среди образцов есть пустой: совпадает везде
+};
+
+typedef struct {
+    uint32_t *go;           // переходы бора, AC_NONE — нет ребра
+    uint32_t *term;
+    uint32_t n, cap, nc;
+} Trie;
+
+static int trie_add_state(Trie *t) {
+    if (t->n == t->cap) {
+        uint32_t new_cap = t->cap ? t->cap * 2 : 256;
+        if ((uint64_t)new_cap * t->nc > AC_MAX_ROW) {
+            errno = E2BIG;
+            return -1;
+        }
+        uint32_t *go = realloc(t->go, (size_t)new_cap * t->nc * sizeof(uint32_t));
+        if (!go) return -1;
+        t->go = go;
+        uint32_t *term = realloc(t->term, (size_t)new_cap * sizeof(uint32_t));
+        if (!term) return -1;
+        t->term = term;
+        t->cap = new_cap;
+    }
+    uint32_t s = t->n++;
+    for (uint32_t c = 0; c < t->nc; ++c) t->go[(size_t)s * t->nc + c] = AC_NONE;
+    t->term[s] = 0;
+    return (int)s;
+}
+
+AcAutomaton *ac_build(const char *const *pats, const size_t *lens, size_t n, bool nocase) {
+    AcAutomaton *ac = calloc(1, sizeof(*ac));
+    if (!ac) return NULL;
+
+    // классы байтов: 0 — «ни в одном образце»; без учёта регистра
+    // обе буквы попадают в один класс, и вход не нужно переписывать
+    ac->nclasses = 1;
+    for (size_t i = 0; i < n; ++i) {
+        const uint8_t *p = (const uint8_t *)pats[i];
+        for (size_t j = 0; j < lens[i]; ++j) {
+            if (ac->cls[p[j]] != 0) continue;
+            ac->cls[p[j]] = (uint16_t)ac->nclasses++;
+            uint8_t other = p[j] ^ 0x20;
+            if (nocase && (uint8_t)((p[j] | 0x20) - 'a') < 26) ac->cls[other] = ac->cls[p[j]];
+        }
+        if (lens[i] == 0) ac->match_empty = true;
+    }
+
+    Trie t = { .nc = ac->nclasses };
+    uint32_t *fail = NULL, *queue = NULL;
+    if (trie_add_state(&t) < 0) goto fail;
+
+    for (size_t i = 0; i < n; ++i) {
+        const uint8_t *p = (const uint8_t *)pats[i];
+        uint32_t s = 0;
+        for (size_t j = 0; j < lens[i]; ++j) {
+            uint32_t *edge = &t.go[(size_t)s * t.nc + ac->cls[p[j]]];
+            if (*edge == AC_NONE) {
+                int ns = trie_add_state(&t);
+                if (ns < 0) goto fail;
+                edge = &t.go[(size_t)s * t.nc + ac->cls[p[j]]];   // go мог переехать
+                *edge = (uint32_t)ns;
+            }
+            s = *edge;
+        }
+        t.term[s] = (uint32_t)lens[i];   // у корня 0: пустой образец учтён в match_empty
+    }
+
+    fail = calloc(t.n, sizeof(uint32_t));
+    queue = malloc((size_t)t.n * sizeof(uint32_t));
+    ac->out_len = calloc(t.n, sizeof(uint32_t));
+    if (!fail || !queue || !ac->out_len) goto fail;
+
+    // BFS: суффиксные ссылки и достраивание бора до полного автомата
+    uint32_t qh = 0, qt = 0;
+    for (uint32_t c = 0; c < t.nc; ++c) {
+        uint32_t *edge = &t.go[c];
+        if (*edge == AC_NONE) {
+            *edge = 0;
+        } else {
+            fail[*edge] = 0;
+            queue[qt++] = *edge;
+        }
+    }
+    while (qh < qt) {
+        uint32_t s = queue[qh++];
+        ac->out_len[s] = t.term[s] ? t.term[s] : ac->out_len[fail[s]];
+        for (uint32_t c = 0; c < t.nc; ++c) {
+            uint32_t *edge = &t.go[(size_t)s * t.nc + c];
+            uint32_t via_fail = t.go[(size_t)fail[s] * t.nc + c];
+            if (*edge == AC_NONE) {
+                *edge = via_fail;
+            } else {
+                fail[*edge] = via_fail;
+                queue[qt++] = *edge;
+            }
+        }
+    }
+
+    // переходы -> смещения строк с флагом допуска, чтобы цикл поиска
+    // обходился без умножения и без отдельной проверки out_len
+    for (size_t i = 0; i < (size_t)t.n * t.nc; ++i) {
+        uint32_t target = t.go[i];
+        t.go[i] = target * t.nc | (ac->out_len[target] ? AC_ACCEPT : 0);
+    }
+
+    ac->nstates = t.n;
+    ac->delta = t.go;
+    free(t.term);
+    free(fail);
+    free(queue);
+    return ac;
+
+fail:
+    free(t.go);
+    free(t.term);
+    free(fail);
+    free(queue);
+    free(ac->out_len);
+    free(ac);
+    return NULL;
+}
+
+void ac_free(AcAutomaton *ac) {
+    if (!ac) return;
+    free(ac->delta);
+    free(ac->out_len);
+    free(ac);
+}
+
+const char *ac_find(const AcAutomaton *ac, const char *p, const char *end, size_t *mlen) {
+    if (ac->match_empty) {
+        *mlen = 0;
+        return p;
+    }
+
+    const uint32_t *delta = ac->delta;
+    const uint16_t *cls = ac->cls;
+    uint32_t row = 0;
+    for (const uint8_t *h = (const uint8_t *)p; h < (const uint8_t *)end; ++h) {
+        uint32_t e = delta[row + cls[*h]];
+        if (e & AC_ACCEPT) {
+            uint32_t len = ac->out_len[(e & ~AC_ACCEPT) / ac->nclasses];
+            *mlen = len;
+            return (const char *)h + 1 - len;
+        }
+        row = e;
+    }
+    return NULL;
+}
@@ -0,0 +1,21 @@
+#ifndef ACMATCH_H
+#define ACMATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Автомат Ахо-Корасик для поиска множества строк за один проход.
+// Переходы хранятся полной плоской таблицей по классам байтов:
+// байты, которых нет ни в одном образце, сливаются в один класс.
+typedef struct AcAutomaton AcAutomaton;
+
+// NULL — не хватило памяти или автомат слишком велик (errno выставлен).
+// nocase — буквы ASCII сравниваются без учёта регистра
+AcAutomaton *ac_build(const char *const *pats, const size_t *lens, size_t n, bool nocase);
+void ac_free(AcAutomaton *ac);
+
+// Самое раннее по концу вхождение любого образца в [p, end) или NULL;
+// в *mlen — длина найденного образца
+const char *ac_find(const AcAutomaton *ac, const char *p, const char *end, size_t *mlen);
+
+#endif
@@ -0,0 +1,222 @@
+// Детерминированный корпус для бенчмарков mycat/mygrep.
+//
+//   gencorpus [-s SIZE] DIR
+//
+// Создаёт в DIR файлы примерно по SIZE байт (по умолчанию 32M):
+//   short.txt   короткие строки (в среднем ~30 байт)
+//   long.txt    длинные строки (2-8 КиБ)
+//   sparse.txt  журнал, где "ERROR" встречается примерно в одной строке из 10000
+//   dense.txt   журнал, где "ERROR" есть почти в каждой строке
+//   binary.bin  случайные байты (с NUL), изредка "ERROR"
+// Генератор псевдослучайных чисел с фиксированным зерном, поэтому при
+// одном SIZE содержимое всегда одно и то же. Файл нужного размера,
+// который уже существует, не перезаписывается.
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define OUT_BUF_SIZE (1 << 20)
+
+static const char *const words[] = {
+    "request", "served", "user", "session", "cache", "miss", "hit", "timeout",
+    "connection", "closed", "opened", "GET", "POST", "/api/v1/items", "200", "404",
+    "latency", "ms", "worker", "queue", "retry", "upstream", "backend", "ok",
+    "the", "a", "of", "to", "in", "and", "id", "token",
+};
+#define N_WORDS (sizeof(words) / sizeof(words[0]))
+
+typedef struct {
+    uint64_t s;
+} Rng;
+
+// xorshift64*: быстрый и одинаковый на всех платформах
+static uint64_t rng_next(Rng *r) {
+    r->s ^= r->s >> 12;
+    r->s ^= r->s << 25;
+    r->s ^= r->s >> 27;
+    return r->s * 0x2545F4914F6CDD1DULL;
+}
+
+static unsigned rng_below(Rng *r, unsigned n) {
+    return (unsigned)((rng_next(r) >> 32) % n);
+}
+
+typedef struct {
+    int fd;
+    char buf[OUT_BUF_SIZE];
+    size_t len;
+    size_t total;
+    int err;
+} Out;
+
+static void out_flush(Out *o) {
+    size_t off = 0;
+    while (off < o->len && !o->err) {
+        ssize_t n = write(o->fd, o->buf + off, o->len - off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            o->err = n < 0 ? errno : EIO;
+            break;
+        }
+        off += (size_t)n;
+    }
+    o->len = 0;
+}
+
+static void out_put(Out *o, const char *p, size_t n) {
+    while (n > 0) {
+        size_t k = OUT_BUF_SIZE - o->len < n ? OUT_BUF_SIZE - o->len : n;
+        memcpy(o->buf + o->len, p, k);
+        o->len += k;
+        o->total += k;
+        p += k;
+        n -= k;
+        if (o->len == OUT_BUF_SIZE) out_flush(o);
+    }
+}
+
+static void put_words(Out *o, Rng *r, size_t n_words) {
+    for (size_t i = 0; i < n_words; ++i) {
+        if (i > 0) out_put(o, " ", 1);
+        const char *w = words[rng_below(r, N_WORDS)];
+        out_put(o, w, strlen(w));
+    }
+}
+
+typedef enum { K_SHORT, K_LONG, K_SPARSE, K_DENSE, K_BINARY } Kind;
+
+static void gen_line(Out *o, Rng *r, Kind kind) {
+    char tmp[64];
+    switch (kind) {
+        case K_SHORT:
+            put_words(o, r, 1 + rng_below(r, 6));
+            break;
+        case K_LONG: {
+            size_t target = 2048 + rng_below(r, 6144);
+            size_t start = o->total;
+            while (o->total - start < target) {
+                put_words(o, r, 8);
+                out_put(o, " ", 1);
+            }
+            break;
+        }
+        case K_SPARSE:
+        case K_DENSE: {
+            // "2024-01-01T12:34:56.789 [pid 1234] LEVEL message"
+            int n = snprintf(tmp, sizeof(tmp), "2024-01-%02uT%02u:%02u:%02u.%03u [pid %u] ",
+                             1 + rng_below(r, 28), rng_below(r, 24), rng_below(r, 60),
+                             rng_below(r, 60), rng_below(r, 1000), 100 + rng_below(r, 30000));
+            out_put(o, tmp, (size_t)n);
+            bool error = kind == K_DENSE ? rng_below(r, 10) != 0 : rng_below(r, 10000) == 0;
+            const char *lvl = error ? "ERROR " : rng_below(r, 4) ? "INFO " : "WARN ";
+            out_put(o, lvl, strlen(lvl));
+            put_words(o, r, 4 + rng_below(r, 12));
+            break;
+        }
+        case K_BINARY: {
+            size_t n = 64 + rng_below(r, 4096);
+            for (size_t i = 0; i < n; ++i) {
+                char c = (char)(rng_next(r) >> 56);
+                out_put(o, &c, 1);
+            }
+            if (rng_below(r, 100) == 0) out_put(o, "ERROR", 5);
+            return;   // без '\n': строки случайной длины
+        }
+    }
+    out_put(o, "\n", 1);
+}
+
+static int gen_file(const char *dir, const char *name, Kind kind, size_t size) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISREG(st.st_mode) && (size_t)st.st_size >= size &&
+        (size_t)st.st_size < size + (16 << 10)) {
+        return 0;   // уже сгенерирован
+    }
+
+    Out *o = malloc(sizeof(Out));
+    if (!o) {
+        fprintf(stderr, "gencorpus: out of memory\n");
+        return -1;
+    }
+    o->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (o->fd < 0) {
+        fprintf(stderr, "gencorpus: cannot open '%s': %s\n", path, strerror(errno));
+        free(o);
+        return -1;
+    }
+    o->len = o->total = 0;
+    o->err = 0;
+
+    Rng r = { 0x9E3779B97F4A7C15ULL ^ (uint64_t)kind };
+    while (o->total < size && !o->err) gen_line(o, &r, kind);
+    out_flush(o);
+
+    int rc = 0;
+    if (o->err || close(o->fd) < 0) {
+        fprintf(stderr, "gencorpus: write error on '%s': %s\n", path, strerror(o->err ? o->err : errno));
+        rc = -1;
+    }
+    free(o);
+    return rc;
+}
+
+// Размер с необязательным суффиксом K/M/G; 0 — ошибка
+static size_t parse_size(const char *arg) {
+    char *endp;
+    errno = 0;
+    unsigned long long v = strtoull(arg, &endp, 10);
+    if (errno || endp == arg) return 0;
+    switch (*endp) {
+        case 'G': case 'g': v <<= 10; /* fallthrough */
+        case 'M': case 'm': v <<= 10; /* fallthrough */
+        case 'K': case 'k': v <<= 10; endp++; break;
+        case '\0': break;
+        default: return 0;
+    }
+    return *endp == '\0' ? (size_t)v : 0;
+}
+
+int main(int argc, char **argv) {
+    size_t size = 32 << 20;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:")) != -1) {
+        if (opt == 's' && (size = parse_size(optarg)) != 0) continue;
+        fprintf(stderr, "Usage: %s [-s SIZE] DIR\n", argv[0]);
+        return 2;
+    }
+    if (argc - optind != 1) {
+        fprintf(stderr, "Usage: %s [-s SIZE] DIR\n", argv[0]);
+        return 2;
+    }
+    const char *dir = argv[optind];
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+        fprintf(stderr, "gencorpus: cannot create '%s': %s\n", dir, strerror(errno));
+        return 1;
+    }
+
+    static const struct {
+        const char *name;
+        Kind kind;
+    } files[] = {
+        { "short.txt", K_SHORT },
+        { "long.txt", K_LONG },
+        { "sparse.txt", K_SPARSE },
+        { "dense.txt", K_DENSE },
+        { "binary.bin", K_BINARY },
+    };
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); ++i) {
+        if (gen_file(dir, files[i].name, files[i].kind, size) < 0) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,238 @@
+// Сравнение mycat/mygrep с GNU cat/grep на корпусе gencorpus.
+//
+//   harness [-n RUNS] [-o FILE] [-g GNU_DIR] BIN_DIR CORPUS_DIR
+//
+// Каждый случай запускается RUNS раз для нашей утилиты (BIN_DIR/mycat,
+// BIN_DIR/mygrep) и для GNU (cat/grep из PATH или GNU_DIR) при тёплом
+// и холодном кэше страниц. Перед холодным прогоном входной файл выселяется
+// из кэша posix_fadvise(DONTNEED); перед тёплыми — один прогон вхолостую.
+// Вывод утилиты уходит в pipe, который вычитывается и отбрасывается:
+// /dev/null GNU grep распознаёт и останавливается на первом совпадении.
+// stderr утилиты отбрасывается; код выхода последнего прогона — в CSV.
+//
+// Результат — CSV (в FILE или stdout), по строке на случай/реализацию/кэш:
+// медиана времени, пропускная способность по входу, процессорное время
+// (user+sys, медиана) и пиковый RSS (максимум по прогонам).
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#define MAX_RUNS 100
+#define MAX_ARGS 8
+
+// Случай: утилита, аргументы перед именем файла и файл корпуса
+typedef struct {
+    const char *name;
+    const char *tool;           // "cat" или "grep"
+    const char *args[MAX_ARGS]; // до NULL
+    const char *file;
+} Case;
+
+static const Case cases[] = {
+    { "cat-short",       "cat",  { NULL },                      "short.txt" },
+    { "cat-long",        "cat",  { NULL },                      "long.txt" },
+    { "cat-binary",      "cat",  { NULL },                      "binary.bin" },
+    { "cat-n-short",     "cat",  { "-n", NULL },                "short.txt" },
+    { "cat-A-long",      "cat",  { "-A", NULL },                "long.txt" },
+    { "cat-v-binary",    "cat",  { "-v", NULL },                "binary.bin" },
+    { "grep-sparse",     "grep", { "ERROR", NULL },             "sparse.txt" },
+    { "grep-dense",      "grep", { "ERROR", NULL },             "dense.txt" },
+    { "grep-long",       "grep", { "upstream backend", NULL },  "long.txt" },
+    { "grep-i-sparse",   "grep", { "-i", "error", NULL },       "sparse.txt" },
+    { "grep-c-dense",    "grep", { "-c", "ERROR", NULL },       "dense.txt" },
+    { "grep-n-dense",    "grep", { "-n", "ERROR", NULL },       "dense.txt" },
+    { "grep-v-sparse",   "grep", { "-v", "INFO", NULL },        "sparse.txt" },
+    { "grep-E-sparse",   "grep", { "-E", "ERROR.*(timeout|retry)", NULL }, "sparse.txt" },
+    { "grep-multi",      "grep", { "-e", "timeout", "-e", "upstream", "-e", "404", NULL }, "sparse.txt" },
+    { "grep-short",      "grep", { "session cache", NULL },     "short.txt" },
+    { "grep-binary",     "grep", { "ERROR", NULL },             "binary.bin" },
+};
+
+typedef struct {
+    double wall, cpu;
+    long rss_kb;
+    int status;
+} RunStat;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static double tv_sec(struct timeval tv) {
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1e6;
+}
+
+// Выселяет файл из кэша страниц (грязных страниц у корпуса нет)
+static void drop_cache(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+// Запускает argv, вычитывая его stdout; 0 — прогон состоялся
+static int run_once(char *const argv[], RunStat *st) {
+    int pfd[2];
+    if (pipe2(pfd, O_CLOEXEC) < 0) return -1;
+
+    double t0 = now_sec();
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(pfd[0]);
+        close(pfd[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        // сообщения вроде "binary file matches" не нужны; сбой виден по коду выхода
+        int devnull = open("/dev/null", O_WRONLY);
+        if (devnull >= 0) dup2(devnull, STDERR_FILENO);
+        dup2(pfd[1], STDOUT_FILENO);
+        execvp(argv[0], argv);
+        _exit(127);
+    }
+    close(pfd[1]);
+
+    static char sink[1 << 16];
+    for (;;) {
+        ssize_t n = read(pfd[0], sink, sizeof(sink));
+        if (n > 0) continue;
+        if (n < 0 && errno == EINTR) continue;
+        break;
+    }
+    close(pfd[0]);
+
+    struct rusage ru;
+    int status;
+    while (wait4(pid, &status, 0, &ru) < 0) {
+        if (errno != EINTR) return -1;
+    }
+    st->wall = now_sec() - t0;
+    st->cpu = tv_sec(ru.ru_utime) + tv_sec(ru.ru_stime);
+    st->rss_kb = ru.ru_maxrss;
+    st->status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    return 0;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double median(double *v, int n) {
+    qsort(v, (size_t)n, sizeof(double), cmp_double);
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+// Один случай для одной реализации и одного режима кэша; строка CSV
+static int bench_case(FILE *out, const Case *c, const char *impl, const char *prog,
+                      const char *path, off_t bytes, bool cold, int runs) {
+    char *argv[MAX_ARGS + 3];
+    int k = 0;
+    argv[k++] = (char *)prog;
+    for (int i = 0; c->args[i]; ++i) argv[k++] = (char *)c->args[i];
+    argv[k++] = (char *)path;
+    argv[k] = NULL;
+
+    RunStat st;
+    if (!cold && run_once(argv, &st) < 0) return -1;   // прогрев
+
+    double wall[MAX_RUNS], cpu[MAX_RUNS];
+    long rss = 0;
+    int status = 0;
+    for (int i = 0; i < runs; ++i) {
+        if (cold) drop_cache(path);
+        if (run_once(argv, &st) < 0) return -1;
+        wall[i] = st.wall;
+        cpu[i] = st.cpu;
+        if (st.rss_kb > rss) rss = st.rss_kb;
+        status = st.status;
+    }
+
+    double w = median(wall, runs);
+    fprintf(out, "%s,%s,%s,%s,%d,%lld,%.6f,%.1f,%.6f,%ld,%d\n",
+            c->name, c->tool, impl, cold ? "cold" : "warm", runs, (long long)bytes,
+            w, (double)bytes / w / 1e6, median(cpu, runs), rss, status);
+    fflush(out);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int runs = 5;
+    const char *out_path = NULL;
+    const char *gnu_dir = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:o:g:")) != -1) {
+        switch (opt) {
+            case 'n':
+                runs = atoi(optarg);
+                break;
+            case 'o':
+                out_path = optarg;
+                break;
+            case 'g':
+                gnu_dir = optarg;
+                break;
+            default:
+                runs = -1;
+        }
+    }
+    if (argc - optind != 2 || runs < 1 || runs > MAX_RUNS) {
+        fprintf(stderr, "Usage: %s [-n RUNS] [-o FILE] [-g GNU_DIR] BIN_DIR CORPUS_DIR\n", argv[0]);
+        return 2;
+    }
+    const char *bin_dir = argv[optind];
+    const char *corpus = argv[optind + 1];
+
+    FILE *out = stdout;
+    if (out_path && !(out = fopen(out_path, "w"))) {
+        fprintf(stderr, "harness: cannot open '%s': %s\n", out_path, strerror(errno));
+        return 1;
+    }
+
+    // GNU grep без локали: байтовое сравнение, как у mygrep
+    setenv("LC_ALL", "C", 1);
+
+    fprintf(out, "case,tool,impl,cache,runs,bytes,wall_s,mb_per_s,cpu_s,max_rss_kb,exit\n");
+    int rc = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+        const Case *c = &cases[i];
+        char path[4096], mine[4096], gnu[4096];
+        snprintf(path, sizeof(path), "%s/%s", corpus, c->file);
+        snprintf(mine, sizeof(mine), "%s/my%s", bin_dir, c->tool);
+        if (gnu_dir) snprintf(gnu, sizeof(gnu), "%s/%s", gnu_dir, c->tool);
+        else snprintf(gnu, sizeof(gnu), "%s", c->tool);
+
+        struct stat st;
+        if (stat(path, &st) < 0) {
+            fprintf(stderr, "harness: cannot stat '%s': %s\n", path, strerror(errno));
+            rc = 1;
+            continue;
+        }
+        for (int cold = 0; cold <= 1; ++cold) {
+            if (bench_case(out, c, "mine", mine, path, st.st_size, cold, runs) < 0 ||
+                bench_case(out, c, "gnu", gnu, path, st.st_size, cold, runs) < 0) {
+                fprintf(stderr, "harness: %s: %s\n", c->name, strerror(errno));
+                rc = 1;
+            }
+        }
+    }
+
+    if (out != stdout && fclose(out) != 0) {
+        fprintf(stderr, "harness: write error on '%s': %s\n", out_path, strerror(errno));
+        rc = 1;
+    }
+    return rc;
+}
@@ -0,0 +1,120 @@
+// Микробенчмарк ядер поиска подстроки (search.c).
+//
+//   kernels [-n ITER] CORPUS PATTERN...
+//
+// CORPUS целиком читается в память, затем каждое ядро ITER раз проходит
+// его, считая все вхождения образца. Печатает GB/s по каждому ядру с учётом
+// регистра и без (-i), а также замедление -i; для сравнения меряется и
+// memmem из libc.
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../search.h"
+
+static const char *find_memmem(const Searcher *s, const char *p, const char *end) {
+    return memmem(p, (size_t)(end - p), s->pat, s->len);
+}
+
+static char *load_file(const char *path, size_t *len) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return NULL;
+    }
+    char *buf = malloc((size_t)st.st_size + 1);
+    size_t got = 0;
+    while (buf && got < (size_t)st.st_size) {
+        ssize_t n = read(fd, buf + got, (size_t)st.st_size - got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        got += (size_t)n;
+    }
+    close(fd);
+    *len = got;
+    return buf;
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static size_t count_all(const Searcher *s, const char *buf, size_t len) {
+    size_t cnt = 0;
+    const char *end = buf + len;
+    const char *p = buf;
+    while (p < end) {
+        const char *m = searcher_find(s, p, end);
+        if (!m) break;
+        cnt++;
+        p = m + (s->len ? s->len : 1);
+    }
+    return cnt;
+}
+
+// Лучшее время из iters прогонов
+static double run_kernel(const Searcher *s, const char *buf, size_t len, int iters, size_t *cnt) {
+    double best = 1e30;
+    for (int i = 0; i < iters; ++i) {
+        double t0 = now_sec();
+        *cnt = count_all(s, buf, len);
+        double dt = now_sec() - t0;
+        if (dt < best) best = dt;
+    }
+    return best;
+}
+
+int main(int argc, char **argv) {
+    int iters = 5;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        if (opt == 'n') iters = atoi(optarg);
+        else return 2;
+    }
+    if (argc - optind < 2 || iters < 1) {
+        fprintf(stderr, "Usage: %s [-n ITER] CORPUS PATTERN...\n", argv[0]);
+        return 2;
+    }
+
+    size_t len;
+    char *buf = load_file(argv[optind], &len);
+    if (!buf) {
+        fprintf(stderr, "kernels: cannot read '%s': %s\n", argv[optind], strerror(errno));
+        return 1;
+    }
+    printf("corpus %s: %zu bytes, best of %d runs\n", argv[optind], len, iters);
+
+    for (int i = optind + 1; i < argc; ++i) {
+        Searcher s, si;
+        searcher_init(&s, argv[i], strlen(argv[i]), false);
+        searcher_init(&si, argv[i], strlen(argv[i]), true);
+        printf("pattern \"%s\":\n", argv[i]);
+        for (const SearchKernel *k = search_kernels(); k->fn; ++k) {
+            size_t cnt, cnt_i;
+            s.find = si.find = k->fn;
+            double t = run_kernel(&s, buf, len, iters, &cnt);
+            double ti = run_kernel(&si, buf, len, iters, &cnt_i);
+            printf("  %-8s %10zu matches %8.2f GB/s   -i: %10zu matches %8.2f GB/s (%+.0f%%)\n",
+                   k->name, cnt, (double)len / t / 1e9, cnt_i, (double)len / ti / 1e9,
+                   (ti / t - 1.0) * 100.0);
+        }
+        size_t cnt;
+        s.find = find_memmem;
+        double t = run_kernel(&s, buf, len, iters, &cnt);
+        printf("  %-8s %10zu matches %8.2f GB/s\n", "memmem", cnt, (double)len / t / 1e9);
+    }
+
+    free(buf);
+    return 0;
+}
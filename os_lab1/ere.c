@@ -0,0 +1,1059 @@
+#define _GNU_SOURCE
+#include "ere.h"
+#include "search.h"
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ERE_MAX_REPEAT  1000        // предел m и n в {m,n}
+#define ERE_MAX_DEPTH   1000        // вложенность скобок
+#define ERE_MAX_NFA     (1 << 20)   // состояний НКА
+#define LIT_MAX         64          // длина обязательной подстроки
+
+#define DFA_CACHE_LIMIT (8u << 20)  // память кэша ДКА на поток
+#define DFA_STATE_COST  32          // служебные байты на состояние сверх таблицы и множества
+#define DFA_MIN_STATES  3           // столько состояний помещается всегда
+#define DFA_THRASH_RATE 64          // байт входа на состояние между сбросами: меньше — кэш «молотит»
+#define DFA_THRASH_MAX  4           // столько таких сбросов подряд — дальше без кэша, по НКА
+
+// Значения переходов ДКА, кроме смещений строк таблицы
+#define T_UNKNOWN  (-1)             // ещё не вычислен
+#define T_MATCH    (-2)             // строка совпала
+#define T_FALLBACK (-3)             // кэш отключён, продолжать по НКА
+
+typedef struct {
+    uint64_t w[4];
+} ByteSet;
+
+static inline bool bs_has(const ByteSet *s, unsigned c) {
+    return (s->w[c >> 6] >> (c & 63)) & 1;
+}
+
+static inline void bs_add(ByteSet *s, unsigned c) {
+    s->w[c >> 6] |= 1ull << (c & 63);
+}
+
+// ---- Синтаксическое дерево ----
+
+enum { R_SET, R_CAT, R_ALT, R_REP, R_BOL, R_EOL, R_EMPTY };
+
+typedef struct {
+    int type;
+    int a, b;           // дети CAT и ALT; у REP — только a
+    int min, max;       // REP: max == -1 — без верхней границы
+    int set;            // R_SET: индекс в sets
+} Node;
+
+typedef struct {
+    const char *p, *end;
+    int depth;          // вложенность скобок
+    bool nocase;        // -i: буквы ASCII в обоих регистрах
+    Node *nodes;
+    int n_nodes, cap_nodes;
+    ByteSet *sets;
+    int n_sets, cap_sets;
+    char err[128];
+} Parser;
+
+static int parse_error(Parser *ps, const char *fmt, ...) {
+    if (ps->err[0] == '\0') {
+        va_list ap;
+        va_start(ap, fmt);
+        vsnprintf(ps->err, sizeof(ps->err), fmt, ap);
+        va_end(ap);
+    }
+    return -1;
+}
+
+static int new_node(Parser *ps, int type, int a, int b) {
+    if (ps->n_nodes == ps->cap_nodes) {
+        int cap = ps->cap_nodes ? ps->cap_nodes * 2 : 64;
+        Node *nodes = realloc(ps->nodes, (size_t)cap * sizeof(Node));
+        if (!nodes) return parse_error(ps, "out of memory");
+        ps->nodes = nodes;
+        ps->cap_nodes = cap;
+    }
+    Node *nd = &ps->nodes[ps->n_nodes];
+    memset(nd, 0, sizeof(*nd));
+    nd->type = type;
+    nd->a = a;
+    nd->b = b;
+    return ps->n_nodes++;
+}
+
+static int new_set(Parser *ps, const ByteSet *s) {
+    if (ps->n_sets == ps->cap_sets) {
+        int cap = ps->cap_sets ? ps->cap_sets * 2 : 16;
+        ByteSet *sets = realloc(ps->sets, (size_t)cap * sizeof(ByteSet));
+        if (!sets) return parse_error(ps, "out of memory");
+        ps->sets = sets;
+        ps->cap_sets = cap;
+    }
+    int n = new_node(ps, R_SET, 0, 0);
+    if (n < 0) return -1;
+    ps->sets[ps->n_sets] = *s;
+    ps->nodes[n].set = ps->n_sets++;
+    return n;
+}
+
+static bool is_ascii_alpha(unsigned c) {
+    return (c | 0x20) - 'a' < 26u;
+}
+
+// -i: к каждой букве множества добавляем её пару другого регистра
+static void fold_case(const Parser *ps, ByteSet *s) {
+    if (!ps->nocase) return;
+    for (unsigned c = 'A'; c <= 'Z'; ++c) {
+        if (bs_has(s, c) || bs_has(s, c | 0x20)) {
+            bs_add(s, c);
+            bs_add(s, c | 0x20);
+        }
+    }
+}
+
+static int new_byte(Parser *ps, unsigned char c) {
+    ByteSet s = {0};
+    bs_add(&s, c);
+    fold_case(ps, &s);
+    return new_set(ps, &s);
+}
+
+// Классы [:name:] и \w \s — в локали C, как и весь поиск
+static const struct {
+    const char *name;
+    int (*fn)(int);
+} char_classes[] = {
+    { "alpha", isalpha }, { "digit", isdigit }, { "alnum", isalnum },
+    { "upper", isupper }, { "lower", islower }, { "space", isspace },
+    { "blank", isblank }, { "punct", ispunct }, { "print", isprint },
+    { "graph", isgraph }, { "cntrl", iscntrl }, { "xdigit", isxdigit },
+};
+
+static void add_class(ByteSet *s, int (*fn)(int)) {
+    for (int c = 0; c < 256; ++c) {
+        if (fn(c)) bs_add(s, (unsigned)c);
+    }
+}
+
+static int is_word(int c) {
+    return isalnum(c) || c == '_';
+}
+
+static void negate(ByteSet *s) {
+    for (int i = 0; i < 4; ++i) s->w[i] = ~s->w[i];
+}
+
+static int parse_bracket(Parser *ps) {
+    ByteSet s = {0};
+    bool neg = false;
+    if (ps->p < ps->end && *ps->p == '^') {
+        neg = true;
+        ps->p++;
+    }
+    for (bool first = true;; first = false) {
+        if (ps->p >= ps->end) return parse_error(ps, "unmatched '['");
+        unsigned char c = (unsigned char)*ps->p;
+        if (c == ']' && !first) {
+            ps->p++;
+            break;
+        }
+        if (c == '[' && ps->p + 1 < ps->end && ps->p[1] == ':') {
+            const char *name = ps->p + 2;
+            const char *close = memmem(name, (size_t)(ps->end - name), ":]", 2);
+            if (!close) return parse_error(ps, "unmatched '['");
+            size_t len = (size_t)(close - name);
+            size_t i = 0;
+            while (i < sizeof(char_classes) / sizeof(char_classes[0]) &&
+                   !(strlen(char_classes[i].name) == len && memcmp(char_classes[i].name, name, len) == 0))
+                ++i;
+            if (i == sizeof(char_classes) / sizeof(char_classes[0]))
+                return parse_error(ps, "invalid character class '%.*s'", (int)len, name);
+            add_class(&s, char_classes[i].fn);
+            ps->p = close + 2;
+            continue;
+        }
+        if (c == '[' && ps->p + 1 < ps->end && (ps->p[1] == '=' || ps->p[1] == '.'))
+            return parse_error(ps, "'[%c' in brackets is not supported", ps->p[1]);
+
+        ps->p++;
+        if (ps->p + 1 < ps->end && *ps->p == '-' && ps->p[1] != ']') {
+            unsigned char hi = (unsigned char)ps->p[1];
+            if (hi < c) return parse_error(ps, "invalid range end '%c-%c'", c, hi);
+            for (unsigned x = c; x <= hi; ++x) bs_add(&s, x);
+            ps->p += 2;
+        } else {
+            bs_add(&s, c);
+        }
+    }
+    fold_case(ps, &s);     // до отрицания: [^a] с -i не совпадает и с 'A'
+    if (neg) negate(&s);
+    return new_set(ps, &s);
+}
+
+// {m}, {m,}, {,n}, {m,n}: 1 — разобрано, 0 — это не интервал ('{' — обычный символ)
+static int parse_interval(Parser *ps, int *min, int *max) {
+    const char *q = ps->p + 1;
+    long lo = -1, hi;
+    if (q < ps->end && isdigit((unsigned char)*q)) {
+        lo = 0;
+        for (; q < ps->end && isdigit((unsigned char)*q); ++q) {
+            if (lo <= ERE_MAX_REPEAT) lo = lo * 10 + (*q - '0');
+        }
+    }
+    if (lo < 0) {
+        if (q >= ps->end || *q != ',') return 0;
+        lo = 0;     // {,n} — как в GNU grep: {0,n}
+    }
+    hi = lo;
+    if (q < ps->end && *q == ',') {
+        q++;
+        hi = -1;
+        if (q < ps->end && isdigit((unsigned char)*q)) {
+            hi = 0;
+            for (; q < ps->end && isdigit((unsigned char)*q); ++q) {
+                if (hi <= ERE_MAX_REPEAT) hi = hi * 10 + (*q - '0');
+            }
+        }
+    }
+    if (q >= ps->end || *q != '}') return 0;
+    if (lo > ERE_MAX_REPEAT || hi > ERE_MAX_REPEAT) return parse_error(ps, "repetition count too large");
+    if (hi >= 0 && hi < lo) return parse_error(ps, "invalid interval {%ld,%ld}", lo, hi);
+    ps->p = q + 1;
+    *min = (int)lo;
+    *max = (int)hi;
+    return 1;
+}
+
+static int parse_alt(Parser *ps);
+
+static int parse_atom(Parser *ps) {
+    unsigned char c = (unsigned char)*ps->p++;
+    ByteSet s = {0};
+    switch (c) {
+        case '(': {
+            if (++ps->depth > ERE_MAX_DEPTH) return parse_error(ps, "parentheses nested too deeply");
+            int r = parse_alt(ps);
+            if (r < 0) return -1;
+            if (ps->p >= ps->end || *ps->p != ')') return parse_error(ps, "unmatched '('");
+            ps->p++;
+            ps->depth--;
+            return r;
+        }
+        case '[':
+            return parse_bracket(ps);
+        case '.':
+            negate(&s);
+            return new_set(ps, &s);
+        case '^':
+            return new_node(ps, R_BOL, 0, 0);
+        case '$':
+            return new_node(ps, R_EOL, 0, 0);
+        case '\\': {
+            if (ps->p >= ps->end) return parse_error(ps, "trailing backslash");
+            unsigned char e = (unsigned char)*ps->p++;
+            switch (e) {
+                case 'w': case 'W':
+                    add_class(&s, is_word);
+                    if (e == 'W') negate(&s);
+                    return new_set(ps, &s);
+                case 's': case 'S':
+                    add_class(&s, isspace);
+                    if (e == 'S') negate(&s);
+                    return new_set(ps, &s);
+                case 'b': case 'B': case '<': case '>': case '`': case '\'':
+                    return parse_error(ps, "'\\%c' is not supported", e);
+                default:
+                    if (e >= '1' && e <= '9') return parse_error(ps, "back-references are not supported");
+                    return new_byte(ps, e);
+            }
+        }
+        default:
+            // ')' без пары, а также '*', '+', '?', '{' в начале — обычные символы
+            return new_byte(ps, c);
+    }
+}
+
+static int parse_rep(Parser *ps) {
+    int atom = parse_atom(ps);
+    while (atom >= 0 && ps->p < ps->end) {
+        int min = 0, max = 0;
+        char c = *ps->p;
+        if (c == '*') {
+            min = 0, max = -1;
+            ps->p++;
+        } else if (c == '+') {
+            min = 1, max = -1;
+            ps->p++;
+        } else if (c == '?') {
+            min = 0, max = 1;
+            ps->p++;
+        } else if (c == '{') {
+            int r = parse_interval(ps, &min, &max);
+            if (r < 0) return -1;
+            if (r == 0) break;
+        } else {
+            break;
+        }
+        atom = new_node(ps, R_REP, atom, 0);
+        if (atom < 0) return -1;
+        ps->nodes[atom].min = min;
+        ps->nodes[atom].max = max;
+    }
+    return atom;
+}
+
+static int parse_cat(Parser *ps) {
+    int left = -1;
+    while (ps->p < ps->end && *ps->p != '|' && !(*ps->p == ')' && ps->depth > 0)) {
+        int r = parse_rep(ps);
+        if (r < 0) return -1;
+        left = left < 0 ? r : new_node(ps, R_CAT, left, r);
+        if (left < 0) return -1;
+    }
+    return left < 0 ? new_node(ps, R_EMPTY, 0, 0) : left;
+}
+
+static int parse_alt(Parser *ps) {
+    int left = parse_cat(ps);
+    while (left >= 0 && ps->p < ps->end && *ps->p == '|') {
+        ps->p++;
+        int right = parse_cat(ps);
+        if (right < 0) return -1;
+        left = new_node(ps, R_ALT, left, right);
+    }
+    return left;
+}
+
+// ---- Обязательная подстрока ----
+
+// Что известно о совпадениях узла: все начинаются с pre, заканчиваются
+// на suf и содержат best; exact — узел совпадает ровно с pre (== suf).
+typedef struct {
+    bool exact;
+    int npre, nsuf, nbest;
+    char pre[LIT_MAX], suf[LIT_MAX], best[LIT_MAX];
+} Lit;
+
+static void lit_none(Lit *l) {
+    l->exact = false;
+    l->npre = l->nsuf = l->nbest = 0;
+}
+
+static void lit_empty(Lit *l) {
+    lit_none(l);
+    l->exact = true;
+}
+
+// l = a b
+static void lit_cat(Lit *l, const Lit *a, const Lit *b) {
+    Lit r;
+    r.exact = a->exact && b->exact && a->npre + b->npre <= LIT_MAX;
+
+    r.npre = a->npre;
+    memcpy(r.pre, a->pre, (size_t)a->npre);
+    if (a->exact) {
+        int k = b->npre < LIT_MAX - r.npre ? b->npre : LIT_MAX - r.npre;
+        memcpy(r.pre + r.npre, b->pre, (size_t)k);
+        r.npre += k;
+    }
+
+    if (b->exact) {
+        // хвост a->suf + b->suf длиной не больше LIT_MAX
+        int kb = b->nsuf;
+        int ka = a->nsuf < LIT_MAX - kb ? a->nsuf : LIT_MAX - kb;
+        memcpy(r.suf, a->suf + a->nsuf - ka, (size_t)ka);
+        memcpy(r.suf + ka, b->suf, (size_t)kb);
+        r.nsuf = ka + kb;
+    } else {
+        r.nsuf = b->nsuf;
+        memcpy(r.suf, b->suf, (size_t)b->nsuf);
+    }
+
+    // стык a->suf + b->pre — тоже обязательная подстрока
+    char join[LIT_MAX];
+    int ka = a->nsuf, kb = b->npre < LIT_MAX - ka ? b->npre : LIT_MAX - ka;
+    memcpy(join, a->suf, (size_t)ka);
+    memcpy(join + ka, b->pre, (size_t)kb);
+    const char *best = join;
+    int nbest = ka + kb;
+    if (a->nbest > nbest) best = a->best, nbest = a->nbest;
+    if (b->nbest > nbest) best = b->best, nbest = b->nbest;
+    memcpy(r.best, best, (size_t)nbest);
+    r.nbest = nbest;
+    *l = r;
+}
+
+static void lit_node(const Parser *ps, int node, Lit *l) {
+    const Node *nd = &ps->nodes[node];
+    switch (nd->type) {
+        case R_SET: {
+            // литерал — ровно один байт (с -i — буква в обоих регистрах;
+            // подстроку тогда ищем тоже без учёта регистра)
+            const ByteSet *s = &ps->sets[nd->set];
+            int cnt = 0, byte = 0;
+            for (int c = 0; c < 256 && cnt < 3; ++c) {
+                if (bs_has(s, (unsigned)c)) cnt++, byte = c;
+            }
+            if (cnt == 2 && ps->nocase && is_ascii_alpha((unsigned)byte) && bs_has(s, (unsigned)byte ^ 0x20))
+                cnt = 1;
+            if (cnt != 1) {
+                lit_none(l);
+                return;
+            }
+            lit_empty(l);
+            l->pre[0] = l->suf[0] = l->best[0] = (char)byte;
+            l->npre = l->nsuf = l->nbest = 1;
+            return;
+        }
+        case R_CAT: {
+            // цепочка CAT растёт влево — идём по ней циклом, а не рекурсией
+            Lit acc, part;
+            lit_empty(&acc);
+            while (nd->type == R_CAT) {
+                lit_node(ps, nd->b, &part);
+                lit_cat(&acc, &part, &acc);
+                nd = &ps->nodes[nd->a];
+            }
+            lit_node(ps, (int)(nd - ps->nodes), &part);
+            lit_cat(l, &part, &acc);
+            return;
+        }
+        case R_REP:
+            if (nd->min == 0) {
+                lit_none(l);
+                return;
+            }
+            lit_node(ps, nd->a, l);
+            if (!(nd->min == 1 && nd->max == 1)) l->exact = false;
+            return;
+        case R_BOL:
+        case R_EOL:
+        case R_EMPTY:
+            lit_empty(l);
+            return;
+        default:    // R_ALT
+            lit_none(l);
+            return;
+    }
+}
+
+// ---- НКА Томпсона ----
+
+enum { S_SET, S_SPLIT, S_BOL, S_EOL, S_MATCH };
+
+typedef struct {
+    int op;
+    int out, out1;      // out1 — только у SPLIT
+    int set;            // S_SET
+} NState;
+
+struct Ere {
+    NState *nfa;
+    int n_nfa, cap_nfa;
+    int start, match;
+    ByteSet *sets;
+    uint8_t cls[256];   // байт -> класс: байты, неразличимые для всех множеств, сливаются
+    uint8_t cls_rep[256];
+    int n_cls;
+    char eol;           // разделитель строк: '\n', с -z — '\0'
+    int eol_cls;        // у разделителя всегда свой класс — это граница строки
+    bool has_lit;
+    char lit_buf[LIT_MAX];
+    Searcher lit;
+};
+
+static int nfa_new(Ere *re, char *err, int op, int out, int out1, int set) {
+    if (re->n_nfa == re->cap_nfa) {
+        if (re->n_nfa >= ERE_MAX_NFA) {
+            snprintf(err, 128, "regular expression too big");
+            return -1;
+        }
+        int cap = re->cap_nfa ? re->cap_nfa * 2 : 64;
+        NState *nfa = realloc(re->nfa, (size_t)cap * sizeof(NState));
+        if (!nfa) {
+            snprintf(err, 128, "out of memory");
+            return -1;
+        }
+        re->nfa = nfa;
+        re->cap_nfa = cap;
+    }
+    re->nfa[re->n_nfa] = (NState){ op, out, out1, set };
+    return re->n_nfa++;
+}
+
+// Строим автомат с конца: узел получает уже готовое продолжение next
+static int compile(Ere *re, const Parser *ps, int node, int next, char *err) {
+    const Node *nd = &ps->nodes[node];
+    switch (nd->type) {
+        case R_SET:
+            return nfa_new(re, err, S_SET, next, -1, nd->set);
+        case R_BOL:
+            return nfa_new(re, err, S_BOL, next, -1, 0);
+        case R_EOL:
+            return nfa_new(re, err, S_EOL, next, -1, 0);
+        case R_EMPTY:
+            return next;
+        case R_CAT:
+            while (nd->type == R_CAT && next >= 0) {
+                next = compile(re, ps, nd->b, next, err);
+                nd = &ps->nodes[nd->a];
+            }
+            return next < 0 ? -1 : compile(re, ps, (int)(nd - ps->nodes), next, err);
+        case R_ALT: {
+            // цепочка ALT: SPLIT(SPLIT(... , b2), b1), дыра заполняется по ходу
+            int top = -1, hole = -1;
+            while (nd->type == R_ALT) {
+                int b = compile(re, ps, nd->b, next, err);
+                if (b < 0) return -1;
+                int s = nfa_new(re, err, S_SPLIT, -1, b, 0);
+                if (s < 0) return -1;
+                if (hole < 0) top = s; else re->nfa[hole].out = s;
+                hole = s;
+                nd = &ps->nodes[nd->a];
+            }
+            int a = compile(re, ps, (int)(nd - ps->nodes), next, err);
+            if (a < 0) return -1;
+            re->nfa[hole].out = a;
+            return top;
+        }
+        default: {  // R_REP: x{m,n} = x...x (m раз), затем (x(x(x)?)?)? или x*
+            int cur = next;
+            if (nd->max < 0) {
+                int s = nfa_new(re, err, S_SPLIT, -1, next, 0);
+                if (s < 0) return -1;
+                int body = compile(re, ps, nd->a, s, err);
+                if (body < 0) return -1;
+                re->nfa[s].out = body;
+                cur = s;
+            } else {
+                for (int i = 0; i < nd->max - nd->min; ++i) {
+                    int body = compile(re, ps, nd->a, cur, err);
+                    if (body < 0) return -1;
+                    cur = nfa_new(re, err, S_SPLIT, body, next, 0);
+                    if (cur < 0) return -1;
+                }
+            }
+            for (int i = 0; i < nd->min; ++i) {
+                cur = compile(re, ps, nd->a, cur, err);
+                if (cur < 0) return -1;
+            }
+            return cur;
+        }
+    }
+}
+
+// Классы байтов: дробим разбиение каждым множеством, последним — {eol}
+static void build_classes(Ere *re, int n_sets) {
+    memset(re->cls, 0, sizeof(re->cls));
+    int n = 1;
+    for (int s = 0; s <= n_sets; ++s) {
+        int16_t map[512];
+        memset(map, -1, sizeof(map));
+        int nn = 0;
+        for (int b = 0; b < 256; ++b) {
+            bool in = s < n_sets ? bs_has(&re->sets[s], (unsigned)b) : b == (unsigned char)re->eol;
+            int key = re->cls[b] * 2 + in;
+            if (map[key] < 0) map[key] = (int16_t)nn++;
+            re->cls[b] = (uint8_t)map[key];
+        }
+        n = nn;
+    }
+    re->n_cls = n;
+    re->eol_cls = re->cls[(unsigned char)re->eol];
+    for (int b = 0; b < 256; ++b) re->cls_rep[re->cls[b]] = (uint8_t)b;
+}
+
+Ere *ere_compile(const char *const *pats, const size_t *lens, size_t n, bool nocase, char eol,
+                 char *errbuf, size_t errlen) {
+    Parser ps = { .nocase = nocase };
+    Ere *re = calloc(1, sizeof(*re));
+    if (!re) {
+        snprintf(errbuf, errlen, "out of memory");
+        return NULL;
+    }
+    re->eol = eol;
+
+    int root = -1;
+    for (size_t i = 0; i < n; ++i) {
+        ps.p = pats[i];
+        ps.end = pats[i] + lens[i];
+        ps.depth = 0;
+        int r = parse_alt(&ps);
+        if (r >= 0) root = root < 0 ? r : new_node(&ps, R_ALT, root, r);
+        if (r < 0 || root < 0) goto fail;
+    }
+    if (root < 0) {
+        // образцов нет: пустое множество не совпадает ни с чем
+        ByteSet none = {0};
+        root = new_set(&ps, &none);
+        if (root < 0) goto fail;
+    }
+
+    re->match = nfa_new(re, ps.err, S_MATCH, -1, -1, 0);
+    if (re->match < 0) goto fail;
+    re->start = compile(re, &ps, root, re->match, ps.err);
+    if (re->start < 0) goto fail;
+
+    Lit lit;
+    lit_node(&ps, root, &lit);
+    if (lit.nbest > 0) {
+        memcpy(re->lit_buf, lit.best, (size_t)lit.nbest);
+        searcher_init(&re->lit, re->lit_buf, (size_t)lit.nbest, nocase);
+        re->has_lit = true;
+    }
+
+    re->sets = ps.sets;
+    ps.sets = NULL;
+    build_classes(re, ps.n_sets);
+
+    free(ps.nodes);
+    return re;
+
+fail:
+    snprintf(errbuf, errlen, "%s", ps.err[0] ? ps.err : "out of memory");
+    free(ps.nodes);
+    free(ps.sets);
+    free(re->nfa);
+    free(re);
+    return NULL;
+}
+
+// ---- Ленивый ДКА ----
+
+#define F_BOL       1       // состояние начала строки: ^ ещё выполнимо
+#define F_EOL_KNOWN 2
+#define F_EOL_MATCH 4       // перед концом строки совпадение есть (через $)
+
+// Кэш у каждого потока свой: выражение общее и неизменное, а состояния
+// ДКА появляются прямо во время поиска.
+typedef struct {
+    const Ere *re;
+    int n_cls;
+    int32_t *trans;         // trans[row + cls], row = состояние * n_cls
+    uint32_t *set_off;      // множество НКА состояния: pool[set_off, set_off + set_len)
+    uint32_t *set_len;
+    uint8_t *flags;
+    int n_states, cap_states;
+    int *pool;
+    size_t pool_len, pool_cap;
+    int32_t *hash;          // открытая адресация по множествам, -1 — пусто
+    size_t hash_cap;
+    size_t mem;             // учтённая память кэша
+
+    // рабочие массивы размером с НКА
+    uint32_t *mark;
+    uint32_t gen;
+    int *stack, *cur, *nxt, *tmp, *start_set;
+    int n_cur, n_start;
+    bool cur_bol;
+    bool start_match;       // пустое совпадение: подходит любая строка
+
+    uint64_t bytes;         // байт входа с последнего сброса
+    int thrash;
+    bool use_nfa;
+} Dfa;
+
+static void next_gen(Dfa *d) {
+    if (++d->gen == 0) {
+        memset(d->mark, 0, (size_t)d->re->n_nfa * sizeof(uint32_t));
+        d->gen = 1;
+    }
+}
+
+// ε-замыкание s в list: остаются только SET, MATCH и ещё не пройденные EOL
+static void closure(Dfa *d, int s, bool bol, bool eol, int *list, int *n) {
+    const NState *nfa = d->re->nfa;
+    if (d->mark[s] == d->gen) return;
+    d->mark[s] = d->gen;
+    int sp = 0;
+    d->stack[sp++] = s;
+    while (sp > 0) {
+        int x = d->stack[--sp];
+        int f[2] = { -1, -1 };
+        switch (nfa[x].op) {
+            case S_SPLIT:
+                f[0] = nfa[x].out1;
+                f[1] = nfa[x].out;
+                break;
+            case S_BOL:
+                if (bol) f[0] = nfa[x].out;
+                break;
+            case S_EOL:
+                if (eol) f[0] = nfa[x].out;
+                else list[(*n)++] = x;
+                break;
+            default:
+                list[(*n)++] = x;
+                break;
+        }
+        for (int i = 0; i < 2; ++i) {
+            if (f[i] >= 0 && d->mark[f[i]] != d->gen) {
+                d->mark[f[i]] = d->gen;
+                d->stack[sp++] = f[i];
+            }
+        }
+    }
+}
+
+// Шаг НКА по байту класса c; к результату добавляется старт — совпадение
+// может начаться в любом месте строки. true — дошли до MATCH.
+static bool step(Dfa *d, const int *set, int n, int c, int *out, int *nout) {
+    const Ere *re = d->re;
+    unsigned b = re->cls_rep[c];
+    next_gen(d);
+    *nout = 0;
+    for (int i = 0; i < n; ++i) {
+        const NState *ns = &re->nfa[set[i]];
+        if (ns->op == S_SET && bs_has(&re->sets[ns->set], b)) closure(d, ns->out, false, false, out, nout);
+    }
+    closure(d, re->start, false, false, out, nout);
+    return d->mark[re->match] == d->gen;
+}
+
+// Есть ли совпадение, если строка кончается прямо здесь
+static bool eol_match(Dfa *d, const int *set, int n, bool bol) {
+    const Ere *re = d->re;
+    int cnt = 0;
+    next_gen(d);
+    for (int i = 0; i < n; ++i) {
+        const NState *ns = &re->nfa[set[i]];
+        if (ns->op == S_EOL) closure(d, ns->out, bol, true, d->tmp, &cnt);
+    }
+    return d->mark[re->match] == d->gen;
+}
+
+static int cmp_int(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t set_hash(const int *set, int n, uint8_t bol) {
+    uint32_t h = 2166136261u ^ bol;
+    for (int i = 0; i < n; ++i) h = (h ^ (uint32_t)set[i]) * 16777619u;
+    return h;
+}
+
+static void hash_insert(Dfa *d, int s) {
+    size_t mask = d->hash_cap - 1;
+    size_t i = set_hash(d->pool + d->set_off[s], (int)d->set_len[s], d->flags[s] & F_BOL) & mask;
+    while (d->hash[i] >= 0) i = (i + 1) & mask;
+    d->hash[i] = s;
+}
+
+static int dfa_grow(Dfa *d, int n) {
+    if (d->pool_len + (size_t)n > d->pool_cap) {
+        size_t cap = d->pool_cap * 2;
+        while (cap < d->pool_len + (size_t)n) cap *= 2;
+        int *pool = realloc(d->pool, cap * sizeof(int));
+        if (!pool) return -1;
+        d->pool = pool;
+        d->pool_cap = cap;
+    }
+    if (d->n_states < d->cap_states) return 0;
+
+    int cap = d->cap_states * 2;
+    int32_t *trans = realloc(d->trans, (size_t)cap * (size_t)d->n_cls * sizeof(int32_t));
+    if (!trans) return -1;
+    d->trans = trans;
+    uint32_t *off = realloc(d->set_off, (size_t)cap * sizeof(uint32_t));
+    if (!off) return -1;
+    d->set_off = off;
+    uint32_t *len = realloc(d->set_len, (size_t)cap * sizeof(uint32_t));
+    if (!len) return -1;
+    d->set_len = len;
+    uint8_t *flags = realloc(d->flags, (size_t)cap);
+    if (!flags) return -1;
+    d->flags = flags;
+    int32_t *hash = malloc((size_t)cap * 2 * sizeof(int32_t));
+    if (!hash) return -1;
+    free(d->hash);
+    d->hash = hash;
+    d->hash_cap = (size_t)cap * 2;
+    d->cap_states = cap;
+    memset(d->hash, -1, d->hash_cap * sizeof(int32_t));
+    for (int s = 0; s < d->n_states; ++s) hash_insert(d, s);
+    return 0;
+}
+
+#define DFA_FULL (-1)
+#define DFA_OOM  (-2)
+
+// Номер состояния ДКА для множества set (сортируется на месте)
+static int dfa_state(Dfa *d, int *set, int n, uint8_t bol) {
+    qsort(set, (size_t)n, sizeof(int), cmp_int);
+    size_t mask = d->hash_cap - 1;
+    for (size_t i = set_hash(set, n, bol) & mask; d->hash[i] >= 0; i = (i + 1) & mask) {
+        int s = d->hash[i];
+        if (d->set_len[s] == (uint32_t)n && (d->flags[s] & F_BOL) == bol &&
+            memcmp(d->pool + d->set_off[s], set, (size_t)n * sizeof(int)) == 0)
+            return s;
+    }
+
+    size_t cost = (size_t)d->n_cls * sizeof(int32_t) + (size_t)n * sizeof(int) + DFA_STATE_COST;
+    if (d->n_states >= DFA_MIN_STATES && d->mem + cost > DFA_CACHE_LIMIT) return DFA_FULL;
+    if (dfa_grow(d, n) < 0) return DFA_OOM;
+
+    int s = d->n_states++;
+    d->set_off[s] = (uint32_t)d->pool_len;
+    d->set_len[s] = (uint32_t)n;
+    memcpy(d->pool + d->pool_len, set, (size_t)n * sizeof(int));
+    d->pool_len += (size_t)n;
+    d->flags[s] = bol;
+    for (int c = 0; c < d->n_cls; ++c) d->trans[(size_t)s * (size_t)d->n_cls + (size_t)c] = T_UNKNOWN;
+    hash_insert(d, s);
+    d->mem += cost;
+    return s;
+}
+
+// Сброс кэша; состояние 0 — всегда начало строки
+static void dfa_reset(Dfa *d) {
+    d->n_states = 0;
+    d->pool_len = 0;
+    d->mem = 0;
+    memset(d->hash, -1, d->hash_cap * sizeof(int32_t));
+    dfa_state(d, d->start_set, d->n_start, F_BOL);
+}
+
+static bool dfa_eol(Dfa *d, int s) {
+    if (!(d->flags[s] & F_EOL_KNOWN)) {
+        bool m = eol_match(d, d->pool + d->set_off[s], (int)d->set_len[s], d->flags[s] & F_BOL);
+        d->flags[s] |= F_EOL_KNOWN | (m ? F_EOL_MATCH : 0);
+    }
+    return d->flags[s] & F_EOL_MATCH;
+}
+
+// Кэш переполнился: если между сбросами прошло слишком мало входа,
+// строить ДКА дороже, чем моделировать НКА напрямую
+static bool dfa_thrashing(Dfa *d) {
+    if (d->bytes < (uint64_t)d->n_states * DFA_THRASH_RATE) d->thrash++;
+    else d->thrash = 0;
+    d->bytes = 0;
+    return d->thrash >= DFA_THRASH_MAX;
+}
+
+// Вычисляет переход из строки *row по классу c (строка может смениться
+// при сбросе кэша)
+static int32_t dfa_fill(Dfa *d, int32_t *row, int c) {
+    int st = *row / d->n_cls;
+    int32_t val;
+    if (c == d->re->eol_cls) {
+        val = dfa_eol(d, st) ? T_MATCH : 0;
+    } else {
+        int n;
+        if (step(d, d->pool + d->set_off[st], (int)d->set_len[st], c, d->nxt, &n)) {
+            val = T_MATCH;
+        } else {
+            int ns = dfa_state(d, d->nxt, n, 0);
+            if (ns < 0) {
+                // текущее множество пригодится и после сброса, и для НКА
+                d->n_cur = (int)d->set_len[st];
+                memcpy(d->cur, d->pool + d->set_off[st], (size_t)d->n_cur * sizeof(int));
+                d->cur_bol = d->flags[st] & F_BOL;
+                if (ns == DFA_OOM || dfa_thrashing(d)) {
+                    d->use_nfa = true;
+                    return T_FALLBACK;
+                }
+                dfa_reset(d);
+                st = dfa_state(d, d->cur, d->n_cur, d->cur_bol ? F_BOL : 0);
+                ns = dfa_state(d, d->nxt, n, 0);
+                if (st < 0 || ns < 0) {
+                    d->use_nfa = true;
+                    return T_FALLBACK;
+                }
+                *row = st * d->n_cls;
+            }
+            val = ns * d->n_cls;
+        }
+    }
+    d->trans[*row + c] = val;
+    return val;
+}
+
+// Моделирование НКА с множества d->cur: линейно, без кэша
+static const char *nfa_scan(Dfa *d, const char *p, const char *end) {
+    const Ere *re = d->re;
+    int *cur = d->cur, *nxt = d->nxt;
+    int n = d->n_cur;
+    bool bol = d->cur_bol;
+    for (const char *h = p; h < end; ++h) {
+        int c = re->cls[(unsigned char)*h];
+        if (c == re->eol_cls) {
+            if (eol_match(d, cur, n, bol)) return h;
+            memcpy(cur, d->start_set, (size_t)d->n_start * sizeof(int));
+            n = d->n_start;
+            bol = true;
+        } else {
+            int nn;
+            if (step(d, cur, n, c, nxt, &nn)) return h;
+            int *t = cur;
+            cur = nxt;
+            nxt = t;
+            n = nn;
+            bol = false;
+        }
+    }
+    if (end > p && end[-1] != re->eol && eol_match(d, cur, n, bol)) return end - 1;
+    return NULL;
+}
+
+static const char *dfa_scan(Dfa *d, const char *p, const char *end) {
+    if (d->start_match) return p;
+    if (d->use_nfa) {
+        memcpy(d->cur, d->start_set, (size_t)d->n_start * sizeof(int));
+        d->n_cur = d->n_start;
+        d->cur_bol = true;
+        return nfa_scan(d, p, end);
+    }
+
+    const uint8_t *cls = d->re->cls;
+    const int32_t *trans = d->trans;
+    const unsigned char *h = (const unsigned char *)p, *e = (const unsigned char *)end;
+    const unsigned char *mark = h;
+    int32_t row = 0;
+    while (h < e) {
+        int c = cls[*h];
+        int32_t nx = trans[row + c];
+        if (nx >= 0) {
+            row = nx;
+            h++;
+            continue;
+        }
+        if (nx == T_UNKNOWN) {
+            d->bytes += (uint64_t)(h - mark);
+            mark = h;
+            nx = dfa_fill(d, &row, c);
+            trans = d->trans;
+            if (nx == T_FALLBACK) return nfa_scan(d, (const char *)h, end);
+            if (nx >= 0) {
+                row = nx;
+                h++;
+                continue;
+            }
+        }
+        d->bytes += (uint64_t)(h - mark);
+        return (const char *)h;
+    }
+    d->bytes += (uint64_t)(h - mark);
+    if (end > p && end[-1] != d->re->eol && dfa_eol(d, row / d->n_cls)) return end - 1;
+    return NULL;
+}
+
+static void dfa_destroy(void *arg) {
+    Dfa *d = arg;
+    if (!d) return;
+    free(d->trans);
+    free(d->set_off);
+    free(d->set_len);
+    free(d->flags);
+    free(d->pool);
+    free(d->hash);
+    free(d->mark);
+    free(d->stack);
+    free(d->cur);
+    free(d->nxt);
+    free(d->tmp);
+    free(d->start_set);
+    free(d);
+}
+
+static Dfa *dfa_create(const Ere *re) {
+    Dfa *d = calloc(1, sizeof(*d));
+    if (!d) return NULL;
+    size_t n = (size_t)re->n_nfa;
+    d->re = re;
+    d->n_cls = re->n_cls;
+    d->mark = calloc(n, sizeof(uint32_t));
+    d->stack = malloc(n * sizeof(int));
+    d->cur = malloc(n * sizeof(int));
+    d->nxt = malloc(n * sizeof(int));
+    d->tmp = malloc(n * sizeof(int));
+    d->start_set = malloc(n * sizeof(int));
+    d->cap_states = 16;
+    d->trans = malloc((size_t)d->cap_states * (size_t)d->n_cls * sizeof(int32_t));
+    d->set_off = malloc((size_t)d->cap_states * sizeof(uint32_t));
+    d->set_len = malloc((size_t)d->cap_states * sizeof(uint32_t));
+    d->flags = malloc((size_t)d->cap_states);
+    d->hash_cap = (size_t)d->cap_states * 2;
+    d->hash = malloc(d->hash_cap * sizeof(int32_t));
+    d->pool_cap = n < 64 ? 64 : n;
+    d->pool = malloc(d->pool_cap * sizeof(int));
+    if (!d->mark || !d->stack || !d->cur || !d->nxt || !d->tmp || !d->start_set ||
+        !d->trans || !d->set_off || !d->set_len || !d->flags || !d->hash || !d->pool) {
+        dfa_destroy(d);
+        return NULL;
+    }
+
+    next_gen(d);
+    closure(d, re->start, true, false, d->start_set, &d->n_start);
+    d->start_match = d->mark[re->match] == d->gen;
+    dfa_reset(d);
+    return d;
+}
+
+static pthread_key_t dfa_key;
+static pthread_once_t dfa_once = PTHREAD_ONCE_INIT;
+
+static void dfa_key_init(void) {
+    pthread_key_create(&dfa_key, dfa_destroy);
+}
+
+static Dfa *dfa_get(const Ere *re) {
+    pthread_once(&dfa_once, dfa_key_init);
+    Dfa *d = pthread_getspecific(dfa_key);
+    if (d && d->re == re) return d;
+    dfa_destroy(d);
+    d = dfa_create(re);
+    if (!d) {
+        fprintf(stderr, "ere: out of memory\n");
+        exit(2);
+    }
+    pthread_setspecific(dfa_key, d);
+    return d;
+}
+
+const char *ere_find(const Ere *re, const char *p, const char *end) {
+    Dfa *d = dfa_get(re);
+    if (!re->has_lit) return dfa_scan(d, p, end);
+
+    // Сначала быстрый поиск обязательной подстроки; автомат проверяет
+    // только строки, где она нашлась
+    const char *from = p;
+    while (from < end) {
+        const char *q = searcher_find(&re->lit, from, end);
+        if (!q) return NULL;
+        const char *ls = memrchr(from, re->eol, (size_t)(q - from));
+        ls = ls ? ls + 1 : from;
+        const char *nl = memchr(q, re->eol, (size_t)(end - q));
+        const char *le = nl ? nl + 1 : end;
+        const char *m = dfa_scan(d, ls, le);
+        if (m) return m;
+        from = le;
+    }
+    return NULL;
+}
+
+const char *ere_literal(const Ere *re, size_t *len) {
+    if (!re->has_lit) return NULL;
+    *len = re->lit.len;
+    return re->lit_buf;
+}
+
+void ere_free(Ere *re) {
+    if (!re) return;
+    // кэш потоков пула освобождается при их завершении, свой — здесь
+    pthread_once(&dfa_once, dfa_key_init);
+    Dfa *d = pthread_getspecific(dfa_key);
+    if (d && d->re == re) {
+        dfa_destroy(d);
+        pthread_setspecific(dfa_key, NULL);
+    }
+    free(re->nfa);
+    free(re->sets);
+    free(re);
+}
@@ -0,0 +1,31 @@
+#ifndef ERE_H
+#define ERE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Расширенные регулярные выражения (-E) без возвратов: выражение
+// переводится в НКА Томпсона, а ДКА строится из него лениво, по мере
+// встречи новых состояний, в кэше ограниченного размера. Время поиска
+// линейно по длине входа.
+//
+// Поддерживается: литералы, '.', [...] с диапазонами и [:класс:], ^, $,
+// (), |, *, +, ?, {m}, {m,}, {m,n}, \w \W \s \S и экранирование \x.
+// Обратные ссылки и \b \< \> не поддерживаются.
+typedef struct Ere Ere;
+
+// Несколько образцов объединяются через '|'; nocase — буквы ASCII без
+// учёта регистра; eol — разделитель строк ('\n' или '\0' для -z).
+// NULL — ошибка; её текст записывается в errbuf
+Ere *ere_compile(const char *const *pats, const size_t *lens, size_t n, bool nocase, char eol,
+                 char *errbuf, size_t errlen);
+void ere_free(Ere *re);
+
+// Подстрока, которая есть в каждом совпадении (NULL — такой нет)
+const char *ere_literal(const Ere *re, size_t *len);
+
+// p — начало строки. Возвращает указатель внутрь первой совпавшей строки
+// в [p, end) (возможно, на её разделитель) или NULL.
+const char *ere_find(const Ere *re, const char *p, const char *end);
+
+#endif
@@ -1,87 +1,341 @@
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <sys/types.h> 
+#include <sys/stat.h>
+
+#include "input.h"
+#include "osio.h"
+#include "prefetch.h"
+#include "writer.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+#define OUT_BUF_SIZE    (1 << 18)   // накопитель вывода для режимов форматирования
+
+#define PREFETCH_MIN_FILES  4           // с какого числа файлов включать упреждение
+#define PREFETCH_DEPTH      16          // сколько файлов читаем наперёд
+#define PREFETCH_SLOT_SIZE  (1 << 17)   // сколько байт каждого файла читаем наперёд
+
+static int cat_fd(int fd, const char *name) {
+    bool read_failed;
+    fflush(stdout);
+    if (copy_fd(fd, STDOUT_FILENO, &read_failed) == 0) return 0;
+    if (read_failed) {
+        fprintf(stderr, "mycat: read error on '%s': %s\n", name ? name : "stdin", strerror(errno));
+    } else {
+        fprintf(stderr, "mycat: write error: %s\n", strerror(errno));
+    }
+    return -1;
+}
+
+// Много файлов без флагов: пока пишем текущий, следующие уже открываются
+// и читаются. Начало файла берём из слота, хвост больших файлов — cat_fd.
+static int cat_prefetched(Prefetch *pf, int n_files) {
+    int exit_code = 0;
+    for (int k = 0; k < n_files; ++k) {
+        PrefetchItem it;
+        prefetch_next(pf, &it);
 
-// Совместимая реализация getline для Windows
-static ssize_t portable_getline(char **lineptr, size_t *n, FILE *stream) {
-    if (*lineptr == NULL || *n == 0) {
-        *n = 128;
-        *lineptr = malloc(*n);
-        if (*lineptr == NULL) return -1;
-    }
-    
-    size_t i = 0;
-    int c;
-    while ((c = fgetc(stream)) != EOF) {
-        if (i + 1 >= *n) {
-            size_t new_size = *n * 2;
-            char *new_line = realloc(*lineptr, new_size);
-            if (new_line == NULL) return -1;
-            *lineptr = new_line;
-            *n = new_size;
+        if (it.is_stdin) {
+            if (cat_fd(STDIN_FILENO, NULL) < 0) exit_code = 1;
+        } else if (it.deferred) {
+            // fifo, устройство и т.п.: открываем только сейчас, в свою очередь
+            int fd = open(it.name, O_RDONLY);
+            if (fd < 0) {
+                fprintf(stderr, "mycat: cannot open '%s': %s\n", it.name, strerror(errno));
+                exit_code = 1;
+            } else {
+                if (cat_fd(fd, it.name) < 0) exit_code = 1;
+                close(fd);
+            }
+        } else if (it.fd < 0) {
+            fprintf(stderr, "mycat: cannot open '%s': %s\n", it.name, strerror(it.open_err));
+            exit_code = 1;
+        } else {
+            fflush(stdout);
+            if (write_full(STDOUT_FILENO, it.data, it.len) < 0) {
+                fprintf(stderr, "mycat: write error: %s\n", strerror(errno));
+                exit_code = 1;
+            } else if (it.read_err) {
+                fprintf(stderr, "mycat: read error on '%s': %s\n", it.name, strerror(it.read_err));
+                exit_code = 1;
+            } else if (!it.eof && cat_fd(it.fd, it.name) < 0) {
+                exit_code = 1;
+            }
         }
-        
-        (*lineptr)[i++] = (char)c;
-        if (c == '\n') break;
-    }
-    
-    if (i == 0) return -1;
-    
-    (*lineptr)[i] = '\0';
-    return (ssize_t)i;
+
+        prefetch_release(pf, &it);
+    }
+    return exit_code;
 }
 
-static void print_file(FILE *fp, const char *name, bool flag_n, bool flag_b, bool flag_E) {
-    char *line = NULL;
-    size_t cap = 0;
-    ssize_t len;  // меняем size_t на ssize_t
-    unsigned long long lineno = 1;
+// ---------- поиск '\n' в блоке ----------
 
-    while ((len = portable_getline(&line, &cap, fp)) != -1) {
-        int is_empty = (len == 0) || (len == 1 && line[0] == '\n');
-        int number_this = 0;
+typedef const char *(*find_nl_fn)(const char *p, const char *end);
 
-        if (flag_b) {
-            number_this = !is_empty;       // -b нумерует только непустые
-        } else if (flag_n) {
-            number_this = 1;               // -n нумерует все
-        }
+static const char *find_nl_scalar(const char *p, const char *end) {
+    return memchr(p, '\n', (size_t)(end - p));
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("sse2")))
+static const char *find_nl_sse2(const char *p, const char *end) {
+    const __m128i nl = _mm_set1_epi8('\n');
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    return find_nl_scalar(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char *find_nl_avx2(const char *p, const char *end) {
+    const __m256i nl = _mm256_set1_epi8('\n');
+    for (; end - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl));
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    return find_nl_scalar(p, end);
+}
+#endif
+
+// Ядро выбирается один раз по возможностям процессора
+static find_nl_fn select_find_nl(void) {
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return find_nl_avx2;
+    if (__builtin_cpu_supports("sse2")) return find_nl_sse2;
+#endif
+    return find_nl_scalar;
+}
 
-        if (number_this) {
-            // Формат как у cat -n: ширина 6 + таб
-            printf("%6llu\t", lineno++);
+// ---------- -v/-T: таблица экранирования ----------
+
+// Для каждого байта — как его выводить (чистые байты — сами собой, len 1).
+// special[] — байты, на которых останавливается поиск: экранируемые и '\n'.
+typedef struct {
+    unsigned char len[256];
+    char seq[256][4];
+    bool special[256];
+    bool vis, tab;      // -v, -T
+} EscTable;
+
+// Запись в стиле cat -v: ^X для управляющих, ^? для DEL, M- для старшей половины
+static void esc_build(EscTable *t, bool vis, bool tab) {
+    memset(t, 0, sizeof(*t));
+    t->vis = vis;
+    t->tab = tab;
+    for (int b = 0; b < 256; ++b) {
+        char *q = t->seq[b];
+        int c = b;
+        bool plain = b == '\n' || (b == '\t' && !tab) || (!vis && b != '\t');
+        t->special[b] = !plain || b == '\n';
+        if (!plain && c >= 128) {
+            *q++ = 'M';
+            *q++ = '-';
+            c -= 128;
         }
+        if (!plain && c < 32) {
+            *q++ = '^';
+            *q++ = (char)(c + 64);
+        } else if (!plain && c == 127) {
+            *q++ = '^';
+            *q++ = '?';
+        } else {
+            *q++ = (char)c;
+        }
+        t->len[b] = (unsigned char)(q - t->seq[b]);
+    }
+}
+
+// Первый байт из special[] в [p, end) или NULL
+typedef const char *(*find_esc_fn)(const char *p, const char *end, const EscTable *t);
+
+static const char *find_esc_scalar(const char *p, const char *end, const EscTable *t) {
+    for (; p < end; ++p) {
+        if (t->special[(unsigned char)*p]) return p;
+    }
+    return NULL;
+}
 
-        if (flag_E) {
-            // Показываем $ в конце строки
-            if (len > 0 && line[len-1] == '\n') {
-                line[len-1] = '\0';
-                printf("%s$\n", line);
-                line[len-1] = '\n';
+// Векторная проверка диапазонов. Сравнение со знаком: байты 0x80-0xff
+// отрицательны, поэтому "< 0x20" ловит сразу и управляющие, и старшую половину.
+//   -v: < 0x20 или 0x7f, кроме '\t' без -T
+//   -T: '\t'
+//   всегда: '\n'
+#ifdef HAVE_X86_SIMD
+__attribute__((target("sse2")))
+static const char *find_esc_sse2(const char *p, const char *end, const EscTable *t) {
+    const __m128i nl = _mm_set1_epi8('\n'), tab = _mm_set1_epi8('\t');
+    const __m128i sp = _mm_set1_epi8(0x20), del = _mm_set1_epi8(0x7f);
+    const __m128i vis_m = _mm_set1_epi8(t->vis ? -1 : 0);
+    const __m128i tab_m = _mm_set1_epi8(t->tab ? -1 : 0);
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i is_tab = _mm_cmpeq_epi8(v, tab);
+        __m128i ctrl = _mm_or_si128(_mm_cmplt_epi8(v, sp), _mm_cmpeq_epi8(v, del));
+        ctrl = _mm_and_si128(_mm_andnot_si128(is_tab, ctrl), vis_m);
+        __m128i hit = _mm_or_si128(ctrl, _mm_cmpeq_epi8(v, nl));
+        hit = _mm_or_si128(hit, _mm_and_si128(is_tab, tab_m));
+        unsigned mask = (unsigned)_mm_movemask_epi8(hit);
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    return find_esc_scalar(p, end, t);
+}
+
+__attribute__((target("avx2")))
+static const char *find_esc_avx2(const char *p, const char *end, const EscTable *t) {
+    const __m256i nl = _mm256_set1_epi8('\n'), tab = _mm256_set1_epi8('\t');
+    const __m256i sp = _mm256_set1_epi8(0x20), del = _mm256_set1_epi8(0x7f);
+    const __m256i vis_m = _mm256_set1_epi8(t->vis ? -1 : 0);
+    const __m256i tab_m = _mm256_set1_epi8(t->tab ? -1 : 0);
+    for (; end - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i is_tab = _mm256_cmpeq_epi8(v, tab);
+        __m256i ctrl = _mm256_or_si256(_mm256_cmpgt_epi8(sp, v), _mm256_cmpeq_epi8(v, del));
+        ctrl = _mm256_and_si256(_mm256_andnot_si256(is_tab, ctrl), vis_m);
+        __m256i hit = _mm256_or_si256(ctrl, _mm256_cmpeq_epi8(v, nl));
+        hit = _mm256_or_si256(hit, _mm256_and_si256(is_tab, tab_m));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(hit);
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    return find_esc_scalar(p, end, t);
+}
+#endif
+
+static find_esc_fn select_find_esc(void) {
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return find_esc_avx2;
+    if (__builtin_cpu_supports("sse2")) return find_esc_sse2;
+#endif
+    return find_esc_scalar;
+}
+
+#define ESC_DENSE_RUN   16      // столько чистых байт подряд — возвращаемся к SIMD-поиску
+#define ESC_DENSE_MAX   256     // байт входа за один проход плотного режима
+
+// Плотный участок (бинарные данные): после экранируемого байта разворачиваем
+// побайтово по таблице прямо в буфер Writer, пока не встретится '\n' или
+// ESC_DENSE_RUN чистых байт подряд. Возвращает, где остановились.
+static const char *put_dense(Writer *o, const char *p, const char *end, const EscTable *t) {
+    if (end - p > ESC_DENSE_MAX) end = p + ESC_DENSE_MAX;
+    char *q0 = writer_reserve(o, ESC_DENSE_MAX * 4);
+    char *q = q0;
+    int clean = 0;
+    for (; p < end && *p != '\n' && clean < ESC_DENSE_RUN; ++p) {
+        unsigned char c = (unsigned char)*p;
+        memcpy(q, t->seq[c], 4);    // лишние байты перезапишутся следующим
+        q += t->len[c];
+        clean = t->special[c] ? 0 : clean + 1;
+    }
+    writer_commit(o, (size_t)(q - q0));
+    return p;
+}
+
+// Флаги форматирования и выбранные ядра
+typedef struct {
+    bool n, b, E;
+    const EscTable *esc;    // NULL без -v/-T
+    find_nl_fn find_nl;
+    find_esc_fn find_esc;
+} Format;
+
+// Номер строки в формате cat -n ("%6llu\t") без printf
+static void out_lineno(Writer *o, unsigned long long v) {
+    char tmp[32];
+    char *q = tmp + sizeof(tmp);
+    *--q = '\t';
+    do {
+        *--q = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (tmp + sizeof(tmp) - q < 7) *--q = ' ';
+    writer_put(o, q, (size_t)(tmp + sizeof(tmp) - q));
+}
+
+// Режимы -n/-b/-E/-v/-T: идём по блокам Input (mmap или read), границы строк
+// и экранируемые байты ищем SIMD-ядром, чистые участки копируем целиком,
+// вывод копим в Writer. Строка может переходить через границу блока,
+// поэтому "начало строки" хранится как состояние между блоками.
+static int print_fd(int fd, const char *name, Writer *o, const Format *f) {
+    Input in;
+    if (input_open(&in, fd) < 0) {
+        fprintf(stderr, "mycat: %s: %s\n", name ? name : "stdin", strerror(errno));
+        return -1;
+    }
+
+    unsigned long long lineno = 1;
+    bool at_bol = true;
+    const char *blk;
+    size_t n;
+    int r;
+
+    while ((r = input_next(&in, &blk, &n)) > 0) {
+        const char *p = blk;
+        const char *end = blk + n;
+        while (p < end) {
+            if (at_bol) {
+                if (f->b) {
+                    if (*p != '\n') out_lineno(o, lineno++);   // -b нумерует только непустые
+                } else if (f->n) {
+                    out_lineno(o, lineno++);                   // -n нумерует все
+                }
+                at_bol = false;
+            }
+
+            const char *s = f->esc ? f->find_esc(p, end, f->esc) : f->find_nl(p, end);
+            if (!s) {
+                writer_put(o, p, (size_t)(end - p));
+                break;
+            }
+            if (*s != '\n') {
+                // экранируемый байт: строка продолжается
+                writer_put(o, p, (size_t)(s - p));
+                p = put_dense(o, s, end, f->esc);
+                continue;
+            }
+            if (f->E) {
+                writer_put(o, p, (size_t)(s - p));
+                writer_put(o, "$\n", 2);
+                at_bol = true;
             } else {
-                // строка без завершающего \n
-                printf("%s$", line);
+                writer_put(o, p, (size_t)(s - p) + 1);
+                at_bol = true;
             }
-        } else {
-            fwrite(line, 1, (size_t)len, stdout);
+            p = s + 1;
         }
     }
 
-    if (ferror(fp)) {
+    int rc = 0;
+    if (r < 0) {
         fprintf(stderr, "mycat: read error on '%s': %s\n", name ? name : "stdin", strerror(errno));
+        rc = -1;
     }
+    input_close(&in);
 
-    free(line);
+    // строка без завершающего \n
+    if (f->E && !at_bol) writer_put(o, "$", 1);
+    return rc;
 }
 
-// Остальной код без изменений...
 int main(int argc, char **argv) {
-    bool flag_n = false, flag_b = false, flag_E = false;
+    bool flag_n = false, flag_b = false, flag_E = false, flag_v = false, flag_T = false;
 
-    // разбор коротких флагов в стиле -n -b -E и их комбинаций (-nE, -bE и т.п.)
+    // разбор коротких флагов в стиле -n -b -E и их комбинаций (-nE, -bE и т.п.);
+    // -A = -vET, -e = -vE, -t = -vT
     int i = 1;
     for (; i < argc; ++i) {
         const char *a = argv[i];
@@ -91,35 +345,79 @@ int main(int argc, char **argv) {
             if (a[j] == 'n') flag_n = true;
             else if (a[j] == 'b') flag_b = true;
             else if (a[j] == 'E') flag_E = true;
+            else if (a[j] == 'v') flag_v = true;
+            else if (a[j] == 'T') flag_T = true;
+            else if (a[j] == 'A') flag_v = flag_E = flag_T = true;
+            else if (a[j] == 'e') flag_v = flag_E = true;
+            else if (a[j] == 't') flag_v = flag_T = true;
             else {
                 fprintf(stderr, "mycat: unknown option -- %c\n", a[j]);
-                fprintf(stderr, "Usage: mycat [-n] [-b] [-E] [FILE ...]\n");
+                fprintf(stderr, "Usage: mycat [-AbeEntTv] [FILE ...]\n");
                 return 1;
             }
         }
     }
 
+    // без флагов форматирования строки не нужны — копируем блоками
+    bool raw = !flag_n && !flag_b && !flag_E && !flag_v && !flag_T;
+
+    Writer out = { .fd = STDOUT_FILENO };
+    static EscTable esc;
+    Format fmt = { .n = flag_n, .b = flag_b, .E = flag_E };
+    if (!raw) {
+        if (writer_init(&out, STDOUT_FILENO, OUT_BUF_SIZE) < 0) {
+            fprintf(stderr, "mycat: out of memory\n");
+            return 1;
+        }
+        fmt.find_nl = select_find_nl();
+        if (flag_v || flag_T) {
+            esc_build(&esc, flag_v, flag_T);
+            fmt.esc = &esc;
+            fmt.find_esc = select_find_esc();
+        }
+    }
+
     // если файлов нет — читаем stdin
-    if (i >= argc) {
-        print_file(stdin, NULL, flag_n, flag_b, flag_E);
-        return ferror(stdout) ? 1 : 0;
+    static char *stdin_only[] = { "-" };
+    char **files = argv + i;
+    int n_files = argc - i;
+    if (n_files == 0) {
+        files = stdin_only;
+        n_files = 1;
     }
 
-    int exit_code = 0;
-    for (; i < argc; ++i) {
-        const char *fname = argv[i];
-        if (strcmp(fname, "-") == 0) {
-            print_file(stdin, NULL, flag_n, flag_b, flag_E);
-            continue;
+    if (raw && n_files >= PREFETCH_MIN_FILES) {
+        Prefetch *pf = prefetch_start(files, n_files, PREFETCH_DEPTH, PREFETCH_SLOT_SIZE);
+        if (pf) {
+            int exit_code = cat_prefetched(pf, n_files);
+            prefetch_stop(pf);
+            return exit_code;
         }
-        FILE *fp = fopen(fname, "r");
-        if (!fp) {
+    }
+
+    int exit_code = 0;
+    for (int k = 0; k < n_files; ++k) {
+        const char *fname = files[k];
+        bool is_stdin = strcmp(fname, "-") == 0;
+        int fd = is_stdin ? STDIN_FILENO : open(fname, O_RDONLY);
+        if (fd < 0) {
             fprintf(stderr, "mycat: cannot open '%s': %s\n", fname, strerror(errno));
             exit_code = 1;
             continue;
         }
-        print_file(fp, fname, flag_n, flag_b, flag_E);
-        fclose(fp);
+        const char *name = is_stdin ? NULL : fname;
+        int r = raw ? cat_fd(fd, name) : print_fd(fd, name, &out, &fmt);
+        if (r < 0) exit_code = 1;
+        if (!is_stdin) close(fd);
+    }
+
+    if (!raw) {
+        writer_flush(&out);
+        if (out.failed) {
+            fprintf(stderr, "mycat: write error: %s\n", strerror(out.err));
+            exit_code = 1;
+        }
+        writer_free(&out);
     }
 
     if (ferror(stdout)) exit_code = 1;
@@ -1,100 +1,1258 @@
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <string.h>
 #include <errno.h>
-#include <sys/types.h> 
-
-// Совместимая реализация getline для Windows
-static ssize_t portable_getline(char **lineptr, size_t *n, FILE *stream) {
-    if (*lineptr == NULL || *n == 0) {
-        *n = 128;
-        *lineptr = malloc(*n);
-        if (*lineptr == NULL) return -1;
-    }
-    
-    size_t i = 0;
-    int c;
-    while ((c = fgetc(stream)) != EOF) {
-        if (i + 1 >= *n) {
-            size_t new_size = *n * 2;
-            char *new_line = realloc(*lineptr, new_size);
-            if (new_line == NULL) return -1;
-            *lineptr = new_line;
-            *n = new_size;
-        }
-        
-        (*lineptr)[i++] = (char)c;
-        if (c == '\n') break;
-    }
-    
-    if (i == 0) return -1;
-    
-    (*lineptr)[i] = '\0';
-    return (ssize_t)i;
-}
-
-static int grep_stream(FILE *fp, const char *srcname, const char *pattern, int print_prefix) {
-    char *line = NULL;
-    size_t cap = 0;
-    ssize_t len;  // меняем на ssize_t
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "acmatch.h"
+#include "ere.h"
+#include "input.h"
+#include "pool.h"
+#include "search.h"
+#include "trigram.h"
+#include "writer.h"
+
+#define SINK_BUF_SIZE (1 << 16)   // буфер вывода при записи прямо в fd
+#define CHUNK_SIZE    (64 << 20)  // кусок большого файла для -j по умолчанию
+#define BINARY_PROBE  (32 << 10)  // сколько байт начала файла проверять на NUL
+#define WALK_BUF_LIMIT ((size_t)32 << 20)   // -r: готовый, но не выведенный вывод
+
+// Список образцов: из -e, из строк файла -f или единственный PATTERN
+typedef struct {
+    const char **pats;
+    size_t *lens;
+    size_t n, cap;
+} PatList;
+
+// Чем ищем: одна строка — SIMD-поиск подстроки, несколько — Ахо-Корасик,
+// с -E — регулярное выражение (ленивый ДКА)
+typedef struct {
+    size_t n_patterns;
+    Searcher srch;
+    AcAutomaton *ac;
+    Ere *re;
+} Matcher;
+
+// Приёмник вывода: Writer (в fd или, при fd == -1, в память — так
+// параллельные задачи копят результат, чтобы потом выдать его строго
+// в порядке аргументов) и признак выведенной группы контекста.
+typedef struct {
+    Writer w;
+    bool grouped;       // уже выведена группа строк контекста: следующей нужен "--"
+} Sink;
+
+typedef struct {
+    Matcher mt;
+    bool many_files;    // печатать "имя:" перед строкой
+    bool recursive;     // -r: каталоги обходятся рекурсивно
+    bool quiet;         // -q: только код возврата, стоп на первом совпадении
+    bool list_files;    // -l: только имена файлов с совпадениями
+    bool count;         // -c: только число совпавших строк
+    long max_count;     // -m: не больше N строк на файл (-1 — без ограничения)
+    bool line_numbers;  // -n: номер строки перед строкой
+    bool invert;        // -v: выбираются несовпавшие строки
+    long before, after; // -B/-A: строк контекста (-1 — контекст не задан)
+    bool text;          // -a: двоичные файлы тоже выводятся как текст
+    char eol;           // разделитель строк: '\n', с -z — '\0'
+    int jobs;
+    size_t chunk_size;  // -j: большие файлы режутся на куски такого размера
+} Opts;
+
+static void usage(void) {
+    fprintf(stderr, "Usage: mygrep [-Eiqlcrnvaz] [-m N] [-A N] [-B N] [-C N] [-j N] [--chunk-size=SIZE] [-e PATTERN]... [-f FILE] [PATTERN] [FILE ...]\n"
+                    "       mygrep [OPTIONS] --index=DIR [-e PATTERN]... [PATTERN]\n"
+                    "       mygrep --build-index=DIR\n");
+}
+
+// Размер с необязательным суффиксом K/M/G; 0 — ошибка
+static size_t parse_size(const char *arg) {
+    char *endp;
+    errno = 0;
+    unsigned long long v = strtoull(arg, &endp, 10);
+    if (errno || endp == arg) return 0;
+    switch (*endp) {
+        case 'G': case 'g': v <<= 10; /* fallthrough */
+        case 'M': case 'm': v <<= 10; /* fallthrough */
+        case 'K': case 'k': v <<= 10; endp++; break;
+        case '\0': break;
+        default: return 0;
+    }
+    return *endp == '\0' ? (size_t)v : 0;
+}
+
+// Вывод задачи — в общий приёмник; группы контекста разных файлов
+// разделяются "--", как если бы файлы искались подряд
+static void sink_splice(Sink *out, const Sink *part) {
+    if (part->grouped && out->grouped) writer_put(&out->w, "--\n", 3);
+    writer_put(&out->w, part->w.buf, part->w.len);
+    out->grouped |= part->grouped;
+}
+
+static int pat_add(PatList *pl, const char *p, size_t len) {
+    if (pl->n == pl->cap) {
+        size_t new_cap = pl->cap ? pl->cap * 2 : 16;
+        const char **pats = realloc(pl->pats, new_cap * sizeof(*pats));
+        if (!pats) return -1;
+        pl->pats = pats;
+        size_t *lens = realloc(pl->lens, new_cap * sizeof(*lens));
+        if (!lens) return -1;
+        pl->lens = lens;
+        pl->cap = new_cap;
+    }
+    pl->pats[pl->n] = p;
+    pl->lens[pl->n] = len;
+    pl->n++;
+    return 0;
+}
+
+// Как в grep: "\n" внутри -e и строки файла -f — отдельные образцы
+static int pat_add_lines(PatList *pl, const char *p, size_t len, int drop_last_empty) {
+    const char *end = p + len;
+    while (p <= end) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        const char *le = nl ? nl : end;
+        if (!nl && drop_last_empty && le == p) break;
+        if (pat_add(pl, p, (size_t)(le - p)) < 0) return -1;
+        p = le + 1;
+    }
+    return 0;
+}
+
+// Читает файл образцов целиком; буфер живёт до конца программы
+static int load_pattern_file(PatList *pl, const char *path) {
+    int fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "mygrep: cannot open '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    size_t len = 0, cap = 4096;
+    char *buf = malloc(cap);
+    int rc = buf ? 0 : -1;
+    while (rc == 0) {
+        if (len == cap) {
+            char *tmp = realloc(buf, cap * 2);
+            if (!tmp) {
+                rc = -1;
+                break;
+            }
+            buf = tmp;
+            cap *= 2;
+        }
+        ssize_t n = read(fd, buf + len, cap - len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "mygrep: read error on '%s': %s\n", path, strerror(errno));
+            rc = -2;
+            break;
+        }
+        if (n == 0) break;
+        len += (size_t)n;
+    }
+    if (fd != STDIN_FILENO) close(fd);
+    if (rc == -1) fprintf(stderr, "mygrep: out of memory\n");
+    if (rc < 0) {
+        free(buf);
+        return -1;
+    }
+
+    if (len == 0) return 0;   // пустой файл — ни одного образца
+    return pat_add_lines(pl, buf, len, 1);
+}
+
+static int matcher_init(Matcher *mt, const PatList *pl, bool extended, bool nocase, char eol) {
+    memset(mt, 0, sizeof(*mt));
+    mt->n_patterns = pl->n;
+    if (extended && pl->n > 0) {
+        char msg[128];
+        mt->re = ere_compile(pl->pats, pl->lens, pl->n, nocase, eol, msg, sizeof(msg));
+        if (!mt->re) {
+            fprintf(stderr, "mygrep: %s\n", msg);
+            return -1;
+        }
+    } else if (pl->n == 1) {
+        searcher_init(&mt->srch, pl->pats[0], pl->lens[0], nocase);
+    } else if (pl->n > 1) {
+        mt->ac = ac_build(pl->pats, pl->lens, pl->n, nocase);
+        if (!mt->ac) {
+            fprintf(stderr, "mygrep: cannot build pattern automaton: %s\n", strerror(errno));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Первое вхождение в [p, end) и его длина; p — начало строки.
+// Для -E позиция — лишь место внутри совпавшей строки, длина 0.
+static const char *matcher_find(const Matcher *mt, const char *p, const char *end, size_t *mlen) {
+    if (mt->re) {
+        *mlen = 0;
+        return ere_find(mt->re, p, end);
+    }
+    if (mt->ac) return ac_find(mt->ac, p, end, mlen);
+    if (mt->n_patterns == 0) return NULL;
+    *mlen = mt->srch.len;
+    return searcher_find(&mt->srch, p, end);
+}
+
+// -q: совпадение уже найдено — остальным задачам можно не работать
+static atomic_bool quiet_matched;
+
+static bool output_lines(const Opts *o) {
+    return !o->quiet && !o->list_files && !o->count;
+}
+
+// Как в grep: NUL в начале файла — признак двоичных данных. Строки таких
+// файлов не выводятся, поиск останавливается на первом совпадении.
+// С -z NUL — разделитель строк, а не признак.
+static bool looks_binary(const Opts *o, const char *p, size_t n) {
+    if (o->text || o->eol != '\n') return false;
+    return memchr(p, '\0', n < BINARY_PROBE ? n : BINARY_PROBE) != NULL;
+}
+
+static void binary_matches(const char *srcname, Sink *out) {
+    writer_printf(&out->w, "Binary file %s matches\n", srcname ? srcname : "(standard input)");
+}
+
+// ---------- -n, -v, -A/-B/-C: построчный режим ----------
+
+// Состояние между блоками Input. Строки не копируются: позиции — указатели
+// в текущий блок (и сохранённые перед ним строки) или смещения от начала
+// входа, которые переживают смену блока.
+typedef struct {
+    const Opts *o;
+    const char *srcname;
+    Sink *out;
+    bool print;
+    const char *blk;        // текущий блок и смещение его начала во входе
+    off_t base;
+    const char *avail;      // отсюда байты перед блоком ещё в памяти (input_keep)
+    const char *nl_at;      // до сюда разделители строк посчитаны (-n)
+    long line_no;           // номер строки, начинающейся в nl_at
+    off_t printed_end;      // конец последней выведенной строки (-1 — ничего)
+    long after_left;        // сколько ещё строк -A напечатать
+    long matches, limit;
+    bool limited;           // -m исчерпан: остался только хвост -A
+} LineState;
+
+// Номер строки, начинающейся в q; счётчик двигается в обе стороны,
+// потому что строки -B лежат раньше уже посчитанного места
+static long line_number(LineState *st, const char *q) {
+    if (q >= st->nl_at) st->line_no += (long)count_byte(st->nl_at, q, st->o->eol);
+    else st->line_no -= (long)count_byte(q, st->nl_at, st->o->eol);
+    st->nl_at = q;
+    return st->line_no;
+}
+
+// Начало k-й строки перед началом строки p, но не раньше lo
+static const char *lines_back(const char *lo, const char *p, long k, char eol) {
+    for (; k > 0 && p > lo; --k) {
+        const char *nl = memrchr(lo, eol, (size_t)(p - 1 - lo));
+        p = nl ? nl + 1 : lo;
+    }
+    return p;
+}
+
+// Конец k-й строки от p, но не дальше end; *taken — сколько строк вышло
+static const char *lines_forward(const char *p, const char *end, long k, char eol, long *taken) {
+    long i = 0;
+    for (; i < k && p < end; ++i) {
+        const char *nl = memchr(p, eol, (size_t)(end - p));
+        p = nl ? nl + 1 : end;
+    }
+    *taken = i;
+    return p;
+}
+
+static void sink_line_no(Sink *s, long n, char sep) {
+    char tmp[24];
+    char *q = tmp + sizeof(tmp);
+    *--q = sep;
+    do {
+        *--q = (char)('0' + n % 10);
+        n /= 10;
+    } while (n > 0);
+    writer_put(&s->w, q, (size_t)(tmp + sizeof(tmp) - q));
+}
+
+// Целые строки [a, b); sep — ':' для выбранных, '-' для контекста
+static void emit_lines(LineState *st, const char *a, const char *b, char sep) {
+    const Opts *o = st->o;
+    Sink *out = st->out;
+    if (o->before >= 0 || o->after >= 0) {
+        off_t at = st->base + (a - st->blk);
+        if (st->printed_end >= 0 ? at != st->printed_end : out->grouped) writer_put(&out->w, "--\n", 3);
+        out->grouped = true;
+    }
+    st->printed_end = st->base + (b - st->blk);
+
+    bool prefix = o->many_files && st->srcname;
+    if (!prefix && !o->line_numbers) {
+        writer_put(&out->w, a, (size_t)(b - a));   // без префиксов — весь кусок сразу
+        return;
+    }
+    while (a < b) {
+        const char *nl = memchr(a, o->eol, (size_t)(b - a));
+        const char *next = nl ? nl + 1 : b;
+        if (prefix) {
+            writer_put(&out->w, st->srcname, strlen(st->srcname));
+            writer_put(&out->w, &sep, 1);
+        }
+        if (o->line_numbers) sink_line_no(out, line_number(st, a), sep);
+        writer_put(&out->w, a, (size_t)(next - a));
+        a = next;
+    }
+}
+
+// Невыбранные строки [a, b): первые after_left из них — контекст -A.
+// false — дальше вход можно не читать
+static bool skip_lines(LineState *st, const char *a, const char *b) {
+    if (st->after_left > 0 && a < b) {
+        long taken;
+        const char *e = lines_forward(a, b, st->after_left, st->o->eol, &taken);
+        emit_lines(st, a, e, '-');
+        st->after_left -= taken;
+    }
+    return !st->limited || st->after_left > 0;
+}
+
+// Выбранные строки [a, b): совпавшие, а с -v — несовпавшие
+static bool select_lines(LineState *st, const char *a, const char *b) {
+    if (a == b) return true;
+    if (st->limited) return skip_lines(st, a, b);
+
+    const char *rest = b;
+    char eol = st->o->eol;
+    long k = (long)count_byte(a, b, eol) + (b[-1] != eol);
+    if (st->limit >= 0 && st->matches + k >= st->limit) {
+        b = lines_forward(a, b, st->limit - st->matches, eol, &k);
+        st->limited = true;
+    }
+    st->matches += k;
+    if (st->print) {
+        if (st->o->before > 0) {
+            // -B: не раньше уже выведенного и того, что ещё в памяти
+            const char *lo = st->avail;
+            if (st->printed_end > st->base - (st->blk - lo)) lo = st->blk + (st->printed_end - st->base);
+            const char *from = lines_back(lo, a, st->o->before, eol);
+            if (from < a) emit_lines(st, from, a, '-');
+        }
+        emit_lines(st, a, b, ':');
+        st->after_left = st->o->after;
+    }
+    return skip_lines(st, b, rest);
+}
+
+// Поиск, когда нужны сами строки вокруг совпадений: номера, контекст
+// или несовпавшие строки. Вход по-прежнему просматривается поиском по
+// всему блоку; строки между совпадениями разбираются, только если их
+// надо вывести, а номера считаются векторным подсчётом разделителей.
+static int grep_lines(Input *in, const char *srcname, bool probe, const Opts *o, Sink *out, Writer *err) {
+    const Matcher *mt = &o->mt;
+    LineState st = {
+        .o = o, .srcname = srcname, .out = out, .print = output_lines(o),
+        .line_no = 1, .printed_end = -1,
+        .limit = (o->quiet || o->list_files) ? 1 : o->max_count,
+    };
+    if (st.limit == 0) return 0;
+
+    const char *blk;
+    size_t n;
+    int r = 0;
+    bool go = true, binary = false;
+    while (go && (r = input_next_records(in, o->eol, &blk, &n)) > 0) {
+        if (o->quiet && atomic_load_explicit(&quiet_matched, memory_order_relaxed)) break;
+        if (probe && st.print && looks_binary(o, blk, n)) {
+            binary = true;
+            st.print = false;
+            st.limit = 1;
+        }
+        probe = false;
+
+        const char *end = blk + n;
+        st.blk = st.nl_at = blk;
+        st.avail = blk - in->kept;
+
+        const char *line = blk;     // начало первой необработанной строки
+        const char *from = blk;     // откуда продолжать поиск
+        while (go && line < end) {
+            if (st.limited) {
+                go = skip_lines(&st, line, end);
+                break;
+            }
+            size_t mlen;
+            const char *m = from < end ? matcher_find(mt, from, end, &mlen) : NULL;
+            const char *ms = end, *next = end;   // совпавшая строка [ms, next)
+            if (m) {
+                const char *nl = memchr(m, o->eol, (size_t)(end - m));
+                next = nl ? nl + 1 : end;
+                if (m + mlen > next) {
+                    from = m + 1;   // вхождение захватывает следующую строку
+                    continue;
+                }
+                ms = memrchr(line, o->eol, (size_t)(m - line));
+                ms = ms ? ms + 1 : line;
+            }
+            go = o->invert ? select_lines(&st, line, ms) : skip_lines(&st, line, ms);
+            if (go && ms < end) go = o->invert ? skip_lines(&st, ms, next) : select_lines(&st, ms, next);
+            line = from = next;
+        }
+
+        if (o->line_numbers && st.print) line_number(&st, end);
+        st.base += (off_t)n;
+        // -B: последние строки блока понадобятся после перечитывания буфера
+        if (o->before > 0 && st.print) {
+            const char *lo = st.avail;
+            if (st.printed_end > st.base - (end - lo)) lo = end - (st.base - st.printed_end);
+            input_keep(in, lines_back(lo, end, o->before, o->eol));
+        }
+    }
+
+    if (go && r < 0) {
+        writer_printf(err, "mygrep: read error on '%s': %s\n", srcname ? srcname : "stdin", strerror(errno));
+        return -1;
+    }
+    if (binary && st.matches > 0) binary_matches(srcname, out);
+    if (o->quiet && st.matches > 0) atomic_store(&quiet_matched, true);
+    return (int)st.matches;
+}
+
+// Поиск по уже открытому Input (весь файл или его кусок). probe —
+// проверить первый блок на двоичные данные; для кусков -j это уже
+// сделано по началу файла (plan_units)
+static int grep_input(Input *in, const char *srcname, bool probe, const Opts *o, Sink *out, Writer *err) {
+    if (o->invert || o->line_numbers || o->before >= 0 || o->after >= 0) {
+        return grep_lines(in, srcname, probe, o, out, err);
+    }
+    const Matcher *mt = &o->mt;
     int matches = 0;
+    bool print = output_lines(o);
+    // -q/-l: достаточно первого совпадения, -m: первых N
+    long limit = (o->quiet || o->list_files) ? 1 : o->max_count;
+    if (limit == 0) return 0;
+
+    // Ищем образец сразу по всему блоку; границы строки находим только
+    // вокруг найденного вхождения, несовпадающие строки не разбираем вовсе.
+    const char *blk;
+    size_t n;
+    int r;
+    bool stop = false, binary = false;
+    while (!stop && (r = input_next_records(in, o->eol, &blk, &n)) > 0) {
+        if (o->quiet && atomic_load_explicit(&quiet_matched, memory_order_relaxed)) break;
+        if (probe && print && looks_binary(o, blk, n)) {
+            binary = true;
+            print = false;
+            limit = 1;
+        }
+        probe = false;
+
+        const char *end = blk + n;
+        const char *line = blk;     // начало первой необработанной строки
+        const char *from = blk;     // откуда продолжать поиск
+        while (from < end) {
+            size_t mlen;
+            const char *m = matcher_find(mt, from, end, &mlen);
+            if (!m) break;
+
+            const char *nl = memchr(m, o->eol, (size_t)(end - m));
+            const char *next = nl ? nl + 1 : end;
+            if (m + mlen > next) {
+                // вхождение захватывает следующую строку — не считается
+                from = m + 1;
+                continue;
+            }
 
-    while ((len = portable_getline(&line, &cap, fp)) != -1) {
-        if (strstr(line, pattern) != NULL) {
-            if (print_prefix && srcname) {
-                printf("%s:", srcname);
+            // для -c/-l/-q начало строки не нужно вовсе
+            if (print) {
+                const char *ls = memrchr(line, o->eol, (size_t)(m - line));
+                ls = ls ? ls + 1 : line;
+                if (o->many_files && srcname) {
+                    writer_put(&out->w, srcname, strlen(srcname));
+                    writer_put(&out->w, ":", 1);
+                }
+                writer_put(&out->w, ls, (size_t)(next - ls));
             }
-            fwrite(line, 1, (size_t)len, stdout);
             matches++;
+            line = from = next;
+
+            if (limit >= 0 && matches >= limit) {
+                stop = true;   // дальше файл не читаем
+                break;
+            }
         }
     }
 
-    free(line);
-
-    if (ferror(fp)) {
-        fprintf(stderr, "mygrep: read error on '%s': %s\n", srcname ? srcname : "stdin", strerror(errno));
+    if (!stop && r < 0) {
+        writer_printf(err, "mygrep: read error on '%s': %s\n", srcname ? srcname : "stdin", strerror(errno));
         return -1;
     }
+    if (binary && matches > 0) binary_matches(srcname, out);
+    if (o->quiet && matches > 0) atomic_store(&quiet_matched, true);
     return matches;
 }
 
+// Итог по файлу для -c и -l (печатается после поиска, в том числе по кускам)
+static void file_summary(const Opts *o, const char *fname, int matches, Sink *out) {
+    if (matches < 0 || o->quiet) return;
+    const char *name = strcmp(fname, "-") == 0 ? "(standard input)" : fname;
+    if (o->list_files) {
+        if (matches > 0) writer_printf(&out->w, "%s\n", name);
+    } else if (o->count) {
+        if (o->many_files) writer_printf(&out->w, "%s:%d\n", name, matches);
+        else writer_printf(&out->w, "%d\n", matches);
+    }
+}
+
+static int grep_fd(int fd, const char *srcname, const Opts *o, Sink *out, Writer *err) {
+    Input in;
+    if (input_open(&in, fd) < 0) {
+        writer_printf(err, "mygrep: %s: %s\n", srcname ? srcname : "stdin", strerror(errno));
+        return -1;
+    }
+    int r = grep_input(&in, srcname, true, o, out, err);
+    input_close(&in);
+    return r;
+}
+
+// -1 — ошибка, иначе число совпавших строк
+static int grep_file(const Opts *o, const char *fname, Sink *out, Writer *err) {
+    if (o->quiet && atomic_load(&quiet_matched)) return 0;
+    if (strcmp(fname, "-") == 0) {
+        return grep_fd(STDIN_FILENO, NULL, o, out, err);
+    }
+    int fd = open(fname, O_RDONLY);
+    if (fd < 0) {
+        writer_printf(err, "mygrep: cannot open '%s': %s\n", fname, strerror(errno));
+        return -1;
+    }
+    int r = grep_fd(fd, fname, o, out, err);
+    close(fd);
+    return r;
+}
+
+// Строки, начинающиеся в [start, end) файла (кусок большого файла)
+static int grep_file_range(const Opts *o, const char *fname, off_t start, off_t end,
+                           Sink *out, Writer *err) {
+    if (o->quiet && atomic_load(&quiet_matched)) return 0;
+    int fd = open(fname, O_RDONLY);
+    if (fd < 0) {
+        writer_printf(err, "mygrep: cannot open '%s': %s\n", fname, strerror(errno));
+        return -1;
+    }
+    Input in;
+    int r;
+    if (input_open_range(&in, fd, start, end, o->eol) < 0) {
+        writer_printf(err, "mygrep: %s: %s\n", fname, strerror(errno));
+        r = -1;
+    } else {
+        r = grep_input(&in, fname, false, o, out, err);
+        input_close(&in);
+    }
+    close(fd);
+    return r;
+}
+
+// ---------- -j: параллельный поиск ----------
+
+// Единица работы: файл целиком или кусок большого обычного файла
+typedef struct {
+    int file;
+    bool chunk;
+    off_t start, end;
+    Sink out;
+    Writer err;
+    int result;
+    bool done;
+} Unit;
+
+typedef struct {
+    const Opts *o;
+    char **files;
+    Unit *units;
+    pthread_mutex_t mu;
+    pthread_cond_t cv;
+} ParCtx;
+
+static void grep_task(void *arg, size_t i) {
+    ParCtx *c = arg;
+    Unit *u = &c->units[i];
+    const char *fname = c->files[u->file];
+    writer_init(&u->out.w, -1, 0);
+    u->out.grouped = false;
+    writer_init(&u->err, -1, 0);
+    if (u->chunk) {
+        u->result = grep_file_range(c->o, fname, u->start, u->end, &u->out, &u->err);
+    } else {
+        u->result = grep_file(c->o, fname, &u->out, &u->err);
+        file_summary(c->o, fname, u->result, &u->out);
+    }
+
+    pthread_mutex_lock(&c->mu);
+    u->done = true;
+    pthread_cond_broadcast(&c->cv);
+    pthread_mutex_unlock(&c->mu);
+}
+
+// Двоичный ли файл — по его началу; для файлов, которые режутся на куски:
+// сами куски начало файла не видят
+static bool file_looks_binary(const Opts *o, const char *fname) {
+    if (o->text || o->eol != '\n' || !output_lines(o)) return false;
+    int fd = open(fname, O_RDONLY);
+    if (fd < 0) return false;   // ошибку покажет сама задача
+    char head[BINARY_PROBE];
+    ssize_t n;
+    do {
+        n = pread(fd, head, sizeof(head), 0);
+    } while (n < 0 && errno == EINTR);
+    close(fd);
+    return n > 0 && looks_binary(o, head, (size_t)n);
+}
+
+// Большие обычные файлы режутся на куски по chunk_size байт; границы
+// выравниваются по строкам уже внутри задачи (input_open_range).
+// Двоичные файлы не режем: поиск в них всё равно до первого совпадения.
+static Unit *plan_units(const Opts *o, char **files, int n_files, size_t *n_units) {
+    size_t cap = (size_t)n_files, n = 0;
+    Unit *units = malloc(cap * sizeof(Unit));
+    if (!units) return NULL;
+
+    for (int i = 0; i < n_files; ++i) {
+        off_t size = 0;
+        struct stat st;
+        if (strcmp(files[i], "-") != 0 && stat(files[i], &st) == 0 && S_ISREG(st.st_mode)) {
+            size = st.st_size;
+        }
+        size_t k = 1;
+        // -m и -n считают строки по порядку от начала файла, а контекст
+        // переходит через границы кусков — такие файлы не режем
+        bool whole = o->max_count >= 0 || o->line_numbers || o->before >= 0 || o->after >= 0;
+        if (!whole && size >= (off_t)(2 * o->chunk_size) && !file_looks_binary(o, files[i])) {
+            k = (size_t)((size + (off_t)o->chunk_size - 1) / (off_t)o->chunk_size);
+        }
+        if (n + k > cap) {
+            while (n + k > cap) cap *= 2;
+            Unit *tmp = realloc(units, cap * sizeof(Unit));
+            if (!tmp) {
+                free(units);
+                return NULL;
+            }
+            units = tmp;
+        }
+        for (size_t j = 0; j < k; ++j) {
+            Unit *u = &units[n++];
+            memset(u, 0, sizeof(*u));
+            u->file = i;
+            u->chunk = k > 1;
+            u->start = (off_t)(j * o->chunk_size);
+            u->end = j + 1 == k ? size : (off_t)((j + 1) * o->chunk_size);
+        }
+    }
+    *n_units = n;
+    return units;
+}
+
+// Каждая единица ищется в свой буфер; буферы выдаются по порядку (файлы —
+// в порядке аргументов, куски — в порядке смещений), так что вывод
+// байт-в-байт совпадает с последовательным режимом.
+// Возвращает -1, если параллелить нечего или пул не запустился.
+static int grep_parallel(const Opts *o, char **files, int n_files, Sink *out, Writer *err,
+                         bool *any_match, bool *any_error) {
+    size_t n_units;
+    ParCtx c = { .o = o, .files = files };
+    c.units = plan_units(o, files, n_files, &n_units);
+    if (!c.units) return -1;
+    if (n_units < 2) {
+        free(c.units);
+        return -1;
+    }
+    pthread_mutex_init(&c.mu, NULL);
+    pthread_cond_init(&c.cv, NULL);
+
+    Pool *pool = pool_create(o->jobs, grep_task, &c);
+    if (!pool) {
+        pthread_mutex_destroy(&c.mu);
+        pthread_cond_destroy(&c.cv);
+        free(c.units);
+        return -1;
+    }
+    for (size_t i = 0; i < n_units; ++i) pool_submit(pool, i);
+
+    int file_total = 0;     // сумма по кускам текущего файла (-1 — была ошибка)
+    for (size_t i = 0; i < n_units; ++i) {
+        Unit *u = &c.units[i];
+        pthread_mutex_lock(&c.mu);
+        while (!u->done) pthread_cond_wait(&c.cv, &c.mu);
+        pthread_mutex_unlock(&c.mu);
+
+        sink_splice(out, &u->out);
+        if (u->chunk) {
+            if (u->result < 0 || file_total < 0) file_total = -1;
+            else file_total += u->result;
+            bool last = i + 1 == n_units || c.units[i + 1].file != u->file;
+            if (last) {
+                file_summary(o, files[u->file], file_total, out);
+                file_total = 0;
+            }
+        }
+        writer_flush(&out->w);
+        writer_put(err, u->err.buf, u->err.len);
+        writer_flush(err);
+        if (u->out.w.failed || u->err.failed) {
+            writer_printf(err, "mygrep: out of memory\n");
+            writer_flush(err);
+            *any_error = true;
+        }
+        if (u->result < 0) *any_error = true; else if (u->result > 0) *any_match = true;
+        writer_free(&u->out.w);
+        writer_free(&u->err);
+    }
+
+    pool_wait(pool);
+    pool_destroy(pool);
+    pthread_mutex_destroy(&c.mu);
+    pthread_cond_destroy(&c.cv);
+    free(c.units);
+    return 0;
+}
+
+// ---------- -r: параллельный рекурсивный обход ----------
+
+// Узел дерева обхода. Каталоги читают рабочие потоки пула и сразу ставят
+// в пул своих детей; файлы открываются через openat относительно fd
+// родительского каталога, который закрывается, когда его дети открылись.
+// Главный поток выдаёт результаты обходом дерева в глубину в порядке
+// readdir, поэтому вывод не зависит от числа потоков. Узел, до которого
+// рабочие ещё не добрались, главный поток обрабатывает сам, а рабочие не
+// берут новые узлы, пока готового вывода больше WALK_BUF_LIMIT.
+enum { W_QUEUED, W_RUNNING, W_DONE };
+
+typedef struct WalkNode {
+    struct WalkNode *parent;
+    char *path;             // для вывода и запасного open() при нехватке fd
+    const char *name;       // последний компонент внутри path
+    bool is_dir;
+
+    int fd;                 // каталог: открытый fd
+    size_t fd_users;        // сколько детей ещё не открылись через fd
+    struct WalkNode **kids;
+    size_t n_kids;
+
+    Sink out;
+    Writer err;
+    int result;
+    int state;              // W_* (под mu)
+    int refs;               // выдача и задача пула (под mu)
+} WalkNode;
+
+typedef struct {
+    const Opts *o;
+    Pool *pool;
+    pthread_mutex_t mu;
+    pthread_cond_t cv;      // узел готов или освободился бюджет
+    size_t buffered;        // байт готового, но не выведенного вывода
+} WalkCtx;
+
+static WalkNode *walk_node_new(WalkNode *parent, const char *name, bool is_dir) {
+    WalkNode *n = calloc(1, sizeof(*n));
+    if (!n) return NULL;
+    if (parent) {
+        size_t lp = strlen(parent->path);
+        bool slash = lp > 0 && parent->path[lp - 1] != '/';
+        n->path = malloc(lp + slash + strlen(name) + 1);
+        if (n->path) {
+            memcpy(n->path, parent->path, lp);
+            if (slash) n->path[lp] = '/';
+            strcpy(n->path + lp + slash, name);
+            n->name = n->path + lp + slash;
+        }
+    } else {
+        n->path = strdup(name);
+        n->name = n->path;
+    }
+    if (!n->path) {
+        free(n);
+        return NULL;
+    }
+    n->parent = parent;
+    n->is_dir = is_dir;
+    n->fd = -1;
+    n->state = W_QUEUED;
+    n->refs = 2;
+    writer_init(&n->out.w, -1, 0);
+    writer_init(&n->err, -1, 0);
+    return n;
+}
+
+static void walk_finish(WalkCtx *c, WalkNode *n) {
+    pthread_mutex_lock(&c->mu);
+    n->state = W_DONE;
+    c->buffered += n->out.w.len + n->err.len;
+    pthread_cond_broadcast(&c->cv);
+    pthread_mutex_unlock(&c->mu);
+}
+
+static void walk_unref(WalkCtx *c, WalkNode *n) {
+    pthread_mutex_lock(&c->mu);
+    bool last = --n->refs == 0;
+    pthread_mutex_unlock(&c->mu);
+    if (!last) return;
+    writer_free(&n->out.w);
+    writer_free(&n->err);
+    free(n->kids);
+    free(n->path);
+    free(n);
+}
+
+// Открыть n относительно родителя и отпустить fd родителя
+static int walk_open(WalkCtx *c, WalkNode *n, int flags) {
+    WalkNode *p = n->parent;
+    if (!p) return open(n->path, flags);
+
+    int fd = openat(p->fd, n->name, flags);
+    if (fd < 0 && (errno == EMFILE || errno == ENFILE)) fd = open(n->path, flags);
+    int saved = errno;
+
+    pthread_mutex_lock(&c->mu);
+    if (--p->fd_users == 0) {
+        close(p->fd);
+        p->fd = -1;
+    }
+    pthread_mutex_unlock(&c->mu);
+    errno = saved;
+    return fd;
+}
+
+static void walk_list_dir(WalkCtx *c, WalkNode *n) {
+    n->fd = walk_open(c, n, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (n->fd < 0) {
+        writer_printf(&n->err, "mygrep: cannot open directory '%s': %s\n", n->path, strerror(errno));
+        n->result = -1;
+        return;
+    }
+
+    // fdopendir забирает fd себе, а наш нужен детям для openat
+    int dfd = dup(n->fd);
+    DIR *dir = dfd >= 0 ? fdopendir(dfd) : NULL;
+    if (!dir) {
+        writer_printf(&n->err, "mygrep: cannot read directory '%s': %s\n", n->path, strerror(errno));
+        if (dfd >= 0) close(dfd);
+        n->result = -1;
+        return;
+    }
+
+    size_t cap = 0;
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        const char *name = de->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+
+        // тип берём из d_type; stat только если ФС его не сообщает
+        unsigned char type = de->d_type;
+        if (type == DT_UNKNOWN) {
+            struct stat st;
+            if (fstatat(n->fd, name, &st, AT_SYMLINK_NOFOLLOW) < 0) continue;
+            type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+        }
+        if (type != DT_REG && type != DT_DIR) continue;   // ссылки, устройства, fifo
+        if (type == DT_REG && tindex_is_index_name(name)) continue;   // --build-index
+
+        if (n->n_kids == cap) {
+            cap = cap ? cap * 2 : 16;
+            WalkNode **tmp = realloc(n->kids, cap * sizeof(*tmp));
+            if (!tmp) break;
+            n->kids = tmp;
+        }
+        WalkNode *kid = walk_node_new(n, name, type == DT_DIR);
+        if (!kid) break;
+        n->kids[n->n_kids++] = kid;
+    }
+    closedir(dir);
+
+    n->fd_users = n->n_kids;
+    if (n->n_kids == 0) {
+        close(n->fd);
+        n->fd = -1;
+    }
+}
+
+// Обработка узла; вызывающий держит на него ссылку
+static void walk_run(WalkCtx *c, WalkNode *n) {
+    if (n->is_dir) {
+        walk_list_dir(c, n);
+        walk_finish(c, n);
+        for (size_t i = 0; i < n->n_kids; ++i) pool_submit(c->pool, (size_t)(uintptr_t)n->kids[i]);
+        return;
+    }
+
+    if (c->o->quiet && atomic_load(&quiet_matched)) {
+        n->result = 0;
+    } else if (!n->parent) {
+        n->result = grep_file(c->o, n->path, &n->out, &n->err);
+    } else {
+        int fd = walk_open(c, n, O_RDONLY | O_CLOEXEC | O_NOCTTY);
+        if (fd < 0) {
+            writer_printf(&n->err, "mygrep: cannot open '%s': %s\n", n->path, strerror(errno));
+            n->result = -1;
+        } else {
+            n->result = grep_fd(fd, n->path, c->o, &n->out, &n->err);
+            close(fd);
+        }
+    }
+    file_summary(c->o, n->path, n->result, &n->out);
+    walk_finish(c, n);
+}
+
+static void walk_task(void *arg, size_t task) {
+    WalkCtx *c = arg;
+    WalkNode *n = (WalkNode *)(uintptr_t)task;
+
+    // не убегаем далеко вперёд выдачи; узел, который ей нужен, она возьмёт сама
+    pthread_mutex_lock(&c->mu);
+    while (n->state == W_QUEUED && c->buffered >= WALK_BUF_LIMIT) pthread_cond_wait(&c->cv, &c->mu);
+    bool mine = n->state == W_QUEUED;
+    if (mine) n->state = W_RUNNING;
+    pthread_mutex_unlock(&c->mu);
+
+    if (mine) walk_run(c, n);
+    walk_unref(c, n);
+}
+
+static void walk_emit(WalkCtx *c, WalkNode *n, Sink *out, Writer *err,
+                      bool *any_match, bool *any_error) {
+    pthread_mutex_lock(&c->mu);
+    bool mine = n->state == W_QUEUED;
+    if (mine) n->state = W_RUNNING;
+    pthread_mutex_unlock(&c->mu);
+    if (mine) walk_run(c, n);
+
+    pthread_mutex_lock(&c->mu);
+    while (n->state != W_DONE) pthread_cond_wait(&c->cv, &c->mu);
+    pthread_mutex_unlock(&c->mu);
+
+    sink_splice(out, &n->out);
+    writer_flush(&out->w);
+    writer_put(err, n->err.buf, n->err.len);
+    writer_flush(err);
+    if (n->out.w.failed || n->err.failed) {
+        writer_printf(err, "mygrep: out of memory\n");
+        writer_flush(err);
+        *any_error = true;
+    }
+    if (n->result < 0) *any_error = true; else if (n->result > 0) *any_match = true;
+
+    // выведенное больше не держим: освобождаем бюджет для рабочих
+    pthread_mutex_lock(&c->mu);
+    c->buffered -= n->out.w.len + n->err.len;
+    pthread_cond_broadcast(&c->cv);
+    pthread_mutex_unlock(&c->mu);
+    writer_free(&n->out.w);
+    writer_free(&n->err);
+
+    // узел (и его fd) живёт, пока не выведены дети: они открываются через него
+    for (size_t i = 0; i < n->n_kids; ++i) walk_emit(c, n->kids[i], out, err, any_match, any_error);
+    walk_unref(c, n);
+}
+
+static int grep_recursive(const Opts *o, char **files, int n_files, Sink *out, Writer *err,
+                          bool *any_match, bool *any_error) {
+    WalkCtx c = { .o = o };
+    WalkNode **roots = calloc((size_t)n_files, sizeof(*roots));
+    if (!roots) return -1;
+    pthread_mutex_init(&c.mu, NULL);
+    pthread_cond_init(&c.cv, NULL);
+
+    c.pool = pool_create(o->jobs, walk_task, &c);
+    if (!c.pool) {
+        pthread_mutex_destroy(&c.mu);
+        pthread_cond_destroy(&c.cv);
+        free(roots);
+        return -1;
+    }
+
+    // аргументы командной строки: каталоги обходим, остальное ищем как есть
+    for (int i = 0; i < n_files; ++i) {
+        struct stat st;
+        bool is_dir = strcmp(files[i], "-") != 0 && stat(files[i], &st) == 0 && S_ISDIR(st.st_mode);
+        roots[i] = walk_node_new(NULL, files[i], is_dir);
+        if (!roots[i]) {
+            writer_printf(err, "mygrep: out of memory\n");
+            *any_error = true;
+            break;
+        }
+        pool_submit(c.pool, (size_t)(uintptr_t)roots[i]);
+    }
+
+    for (int i = 0; i < n_files && roots[i]; ++i) {
+        walk_emit(&c, roots[i], out, err, any_match, any_error);
+    }
+
+    pool_wait(c.pool);
+    pool_destroy(c.pool);
+    pthread_mutex_destroy(&c.mu);
+    pthread_cond_destroy(&c.cv);
+    free(roots);
+    return 0;
+}
+
 int main(int argc, char **argv) {
-    if (argc < 2) {
-        fprintf(stderr, "Usage: mygrep PATTERN [FILE ...]\n");
-        return 2; // ошибка использования
+    PatList pl = {0};
+    int have_patterns = 0;
+    bool extended = false;
+    bool nocase = false;
+    Opts o = { .jobs = 1, .chunk_size = CHUNK_SIZE, .max_count = -1, .before = -1, .after = -1,
+               .eol = '\n' };
+    long context = -1;              // -C: для -A/-B, не заданных явно
+
+    const char *build_dir = NULL;   // --build-index
+    const char *index_dir = NULL;   // --index
+
+    enum { OPT_CHUNK_SIZE = 256, OPT_BUILD_INDEX, OPT_INDEX };
+    static const struct option long_opts[] = {
+        { "chunk-size", required_argument, NULL, OPT_CHUNK_SIZE },
+        { "build-index", required_argument, NULL, OPT_BUILD_INDEX },
+        { "index", required_argument, NULL, OPT_INDEX },
+        { NULL, 0, NULL, 0 },
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "Eie:f:j:rqlcm:nvA:B:C:az", long_opts, NULL)) != -1) {
+        switch (opt) {
+            case 'E':
+                extended = true;
+                break;
+            case 'i':
+                nocase = true;
+                break;
+            case 'e':
+                if (pat_add_lines(&pl, optarg, strlen(optarg), 0) < 0) {
+                    fprintf(stderr, "mygrep: out of memory\n");
+                    return 2;
+                }
+                have_patterns = 1;
+                break;
+            case 'f':
+                if (load_pattern_file(&pl, optarg) < 0) return 2;
+                have_patterns = 1;
+                break;
+            case 'j': {
+                char *endp;
+                long v = strtol(optarg, &endp, 10);
+                if (*endp != '\0' || v < 1 || v > 1024) {
+                    fprintf(stderr, "mygrep: invalid number of jobs '%s'\n", optarg);
+                    return 2;
+                }
+                o.jobs = (int)v;
+                break;
+            }
+            case 'r':
+                o.recursive = true;
+                break;
+            case 'q':
+                o.quiet = true;
+                break;
+            case 'l':
+                o.list_files = true;
+                break;
+            case 'c':
+                o.count = true;
+                break;
+            case 'm': {
+                char *endp;
+                errno = 0;
+                long v = strtol(optarg, &endp, 10);
+                if (errno || *endp != '\0' || endp == optarg) {
+                    fprintf(stderr, "mygrep: invalid max count '%s'\n", optarg);
+                    return 2;
+                }
+                o.max_count = v < 0 ? -1 : v;
+                break;
+            }
+            case 'n':
+                o.line_numbers = true;
+                break;
+            case 'v':
+                o.invert = true;
+                break;
+            case 'a':
+                o.text = true;
+                break;
+            case 'z':
+                o.eol = '\0';
+                break;
+            case 'A':
+            case 'B':
+            case 'C': {
+                char *endp;
+                errno = 0;
+                long v = strtol(optarg, &endp, 10);
+                if (errno || *endp != '\0' || endp == optarg || v < 0) {
+                    fprintf(stderr, "mygrep: invalid context length '%s'\n", optarg);
+                    return 2;
+                }
+                if (opt == 'A') o.after = v;
+                else if (opt == 'B') o.before = v;
+                else context = v;
+                break;
+            }
+            case OPT_BUILD_INDEX:
+                build_dir = optarg;
+                break;
+            case OPT_INDEX:
+                index_dir = optarg;
+                break;
+            case OPT_CHUNK_SIZE:
+                o.chunk_size = parse_size(optarg);
+                if (o.chunk_size == 0) {
+                    fprintf(stderr, "mygrep: invalid chunk size '%s'\n", optarg);
+                    return 2;
+                }
+                break;
+            default:
+                usage();
+                return 2; // ошибка использования
+        }
     }
 
-    const char *pattern = argv[1];
+    if (o.after < 0) o.after = context;
+    if (o.before < 0) o.before = context;
 
-    // только stdin (для туннелирования/пайпа)
-    if (argc == 2) {
-        int r = grep_stream(stdin, NULL, pattern, 0);
-        if (r < 0) return 2;
-        return (r > 0) ? 0 : 1;
+    // --build-index только строит индекс, образец не нужен
+    if (build_dir) {
+        free(pl.pats);
+        free(pl.lens);
+        return tindex_build(build_dir) < 0 ? 2 : 0;
     }
 
-    int many_files = (argc - 2) > 1;
-    int any_match = 0;
-    int any_error = 0;
+    // без -e/-f первый аргумент — сам образец (как есть, целиком)
+    if (!have_patterns) {
+        if (optind >= argc) {
+            usage();
+            return 2;
+        }
+        if (pat_add(&pl, argv[optind], strlen(argv[optind])) < 0) return 2;
+        optind++;
+    }
 
-    for (int i = 2; i < argc; ++i) {
-        const char *fname = argv[i];
-        if (strcmp(fname, "-") == 0) {
-            int r = grep_stream(stdin, NULL, pattern, 0);
-            if (r < 0) any_error = 1; else if (r > 0) any_match = 1;
-            continue;
+    if (matcher_init(&o.mt, &pl, extended, nocase, o.eol) < 0) return 2;
+
+    // -m 0: совпадений не будет заведомо, файлы даже не открываем
+    if (o.max_count == 0) return 1;
+
+    // только stdin (для туннелирования/пайпа), а с -r — текущий каталог
+    static char *stdin_only[] = { "-" };
+    static char *cwd_only[] = { "." };
+    char **files = argv + optind;
+    int n_files = argc - optind;
+    if (n_files == 0) {
+        files = o.recursive ? cwd_only : stdin_only;
+        n_files = 1;
+    }
+    o.many_files = n_files > 1;
+    if (o.recursive && !o.many_files) {
+        struct stat st;
+        o.many_files = stat(files[0], &st) == 0 && S_ISDIR(st.st_mode);
+    }
+
+    // --index: смотрим только файлы-кандидаты, изменившиеся и новые;
+    // без индекса — обычный рекурсивный поиск по каталогу
+    char **index_files = NULL;
+    size_t n_index_files = 0;
+    if (index_dir) {
+        if (optind < argc) {
+            usage();
+            return 2;
         }
-        FILE *fp = fopen(fname, "r");
-        if (!fp) {
-            fprintf(stderr, "mygrep: cannot open '%s': %s\n", fname, strerror(errno));
-            any_error = 1;
-            continue;
+        static char *dir_only[1];
+        dir_only[0] = (char *)index_dir;
+        files = dir_only;
+        n_files = 1;
+        o.many_files = true;
+
+        TIndex *ix = tindex_open(index_dir);
+        if (!ix) {
+            fprintf(stderr, "mygrep: cannot use index of '%s': %s; searching without it\n",
+                    index_dir, strerror(errno));
+            o.recursive = true;
+        } else {
+            // для -E сужаем по обязательной подстроке выражения
+            const char *const *lits = pl.pats;
+            const size_t *lens = pl.lens;
+            size_t n_lits = pl.n;
+            const char *re_lit;
+            size_t re_len = 0;
+            if (o.mt.re) {
+                re_lit = ere_literal(o.mt.re, &re_len);
+                lits = &re_lit;
+                lens = &re_len;
+                n_lits = re_lit ? 1 : 0;
+            }
+            // -c печатает и файлы без совпадений (file:0), а при -v совпадают
+            // как раз строки без образца — сужать нельзя
+            if (o.count || o.invert) n_lits = 0;
+            int r = tindex_select(ix, lits, lens, n_lits, &index_files, &n_index_files);
+            tindex_close(ix);
+            if (r < 0) {
+                fprintf(stderr, "mygrep: out of memory\n");
+                return 2;
+            }
+            files = index_files;
+            n_files = (int)n_index_files;
+            o.recursive = false;
+        }
+    }
+
+    Sink out = { .grouped = false };
+    Writer err;
+    if (writer_init(&out.w, STDOUT_FILENO, SINK_BUF_SIZE) < 0 ||
+        writer_init(&err, STDERR_FILENO, SINK_BUF_SIZE) < 0) {
+        fprintf(stderr, "mygrep: out of memory\n");
+        return 2;
+    }
+    bool any_match = false;
+    bool any_error = false;
+
+    int done = -1;
+    if (o.recursive) {
+        done = grep_recursive(&o, files, n_files, &out, &err, &any_match, &any_error);
+    } else if (o.jobs > 1) {
+        done = grep_parallel(&o, files, n_files, &out, &err, &any_match, &any_error);
+    }
+    if (done < 0) {
+        for (int i = 0; i < n_files; ++i) {
+            int r = grep_file(&o, files[i], &out, &err);
+            file_summary(&o, files[i], r, &out);
+            writer_flush(&err);
+            if (r < 0) any_error = true; else if (r > 0) any_match = true;
+            if (o.quiet && any_match) break;
         }
-        int r = grep_stream(fp, many_files ? fname : NULL, pattern, many_files);
-        if (r < 0) any_error = 1; else if (r > 0) any_match = 1;
-        fclose(fp);
     }
 
+    writer_flush(&out.w);
+    if (out.w.failed) {
+        fprintf(stderr, "mygrep: write error: %s\n", strerror(out.w.err));
+        any_error = true;
+    }
+    writer_free(&out.w);
+    writer_free(&err);
+    ac_free(o.mt.ac);
+    ere_free(o.mt.re);
+    tindex_free_list(index_files, n_index_files);
+    free(pl.pats);
+    free(pl.lens);
+
+    // как в grep: с -q найденное совпадение важнее ошибок
+    if (o.quiet && any_match) return 0;
     if (any_error) return 2;
     return any_match ? 0 : 1;
-}
\ No newline at end of file
+}
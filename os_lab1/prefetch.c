@@ -0,0 +1,384 @@
+#define _GNU_SOURCE
+
+#include "prefetch.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "uring.h"
+
+#define PREFETCH_MAX_THREADS 4
+
+enum { OP_STAT = 0, OP_OPEN = 1, OP_READ = 2, N_OPS = 3 };
+
+typedef struct {
+    int idx;            // номер файла в files[]
+    int fd;
+    int open_err;
+    int read_err;
+    char *buf;
+    size_t len;
+    bool eof;
+    bool deferred;      // не обычный файл: не трогаем, откроет сам вывод
+    bool ready;         // open/read для этого файла закончены
+    struct statx stx;   // результат IORING_OP_STATX
+} Slot;
+
+struct Prefetch {
+    char **files;
+    int n_files;
+    int depth;
+    size_t slot_size;
+    Slot *slots;
+    int next_submit;    // первый файл, который ещё не начинали читать
+    int next_out;       // следующий файл для выдачи
+
+    bool use_uring;
+    Ring ring;
+
+    pthread_t threads[PREFETCH_MAX_THREADS];
+    int n_threads;
+    pthread_mutex_t mu;
+    pthread_cond_t cv;
+    bool stop;
+};
+
+static void slot_reset(Slot *s, int idx) {
+    s->idx = idx;
+    s->fd = -1;
+    s->open_err = 0;
+    s->read_err = 0;
+    s->len = 0;
+    s->eof = false;
+    s->deferred = false;
+    s->ready = false;
+}
+
+// Заранее читаем только обычные файлы: open или read fifo, терминала,
+// устройства может заблокироваться или съесть данные раньше времени
+static bool prefetchable(mode_t mode) {
+    return S_ISREG(mode);
+}
+
+static bool is_stdin_name(const char *name) {
+    return strcmp(name, "-") == 0;
+}
+
+// ---------- io_uring ----------
+
+// Каждый слот держит не больше одной операции, так что места в SQ хватает всегда
+static uint64_t slot_tag(const Prefetch *pf, const Slot *s, int op) {
+    return (uint64_t)(s - pf->slots) * N_OPS + (uint64_t)op;
+}
+
+static void uring_read(Prefetch *pf, Slot *s) {
+    struct io_uring_sqe *sqe = ring_sqe(&pf->ring, slot_tag(pf, s, OP_READ));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = s->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(s->buf + s->len);
+    sqe->len = (unsigned)(pf->slot_size - s->len);
+    sqe->off = (uint64_t)-1;   // с текущей позиции: потом дочитываем обычным read
+}
+
+static void uring_open(Prefetch *pf, Slot *s) {
+    struct io_uring_sqe *sqe = ring_sqe(&pf->ring, slot_tag(pf, s, OP_OPEN));
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (uint64_t)(uintptr_t)pf->files[s->idx];
+    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+}
+
+static void uring_submit_file(Prefetch *pf, int idx) {
+    Slot *s = &pf->slots[idx % pf->depth];
+    slot_reset(s, idx);
+    if (is_stdin_name(pf->files[idx])) {
+        s->ready = true;
+        return;
+    }
+    // сначала тип файла, открываем только обычные
+    struct io_uring_sqe *sqe = ring_sqe(&pf->ring, slot_tag(pf, s, OP_STAT));
+    sqe->opcode = IORING_OP_STATX;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (uint64_t)(uintptr_t)pf->files[idx];
+    sqe->len = STATX_TYPE;
+    sqe->off = (uint64_t)(uintptr_t)&s->stx;
+}
+
+static void uring_complete(void *ctx, const struct io_uring_cqe *cqe) {
+    Prefetch *pf = ctx;
+    Slot *s = &pf->slots[cqe->user_data / N_OPS];
+    int op = (int)(cqe->user_data % N_OPS);
+
+    if (op == OP_STAT) {
+        mode_t mode = s->stx.stx_mode;
+        if (cqe->res == -EINVAL) {
+            // ядро без IORING_OP_STATX
+            struct stat st;
+            mode = stat(pf->files[s->idx], &st) == 0 ? st.st_mode : 0;
+        } else if (cqe->res < 0) {
+            mode = 0;   // ошибку сообщит обычный open в свою очередь
+        }
+        if (!prefetchable(mode)) {
+            s->deferred = true;
+            s->ready = true;
+            return;
+        }
+        uring_open(pf, s);
+        return;
+    }
+
+    if (op == OP_OPEN) {
+        if (cqe->res < 0) {
+            s->open_err = -cqe->res;
+            s->ready = true;
+            return;
+        }
+        s->fd = cqe->res;
+        uring_read(pf, s);
+        return;
+    }
+
+    if (cqe->res < 0) {
+        s->read_err = -cqe->res;
+        s->ready = true;
+    } else if (cqe->res == 0) {
+        s->eof = true;
+        s->ready = true;
+    } else {
+        s->len += (size_t)cqe->res;
+        if (s->len == pf->slot_size) s->ready = true;   // остальное — синхронно
+        else uring_read(pf, s);
+    }
+}
+
+// Отправляет накопленное, ждёт хотя бы одно завершение и разбирает CQ
+static int uring_pump(Prefetch *pf) {
+    return ring_pump(&pf->ring, uring_complete, pf);
+}
+
+// Для ring_drain: новых операций не ставим, только запоминаем открытые fd
+static void uring_drained(void *ctx, const struct io_uring_cqe *cqe) {
+    Prefetch *pf = ctx;
+    Slot *s = &pf->slots[cqe->user_data / N_OPS];
+    if (cqe->user_data % N_OPS == OP_OPEN && cqe->res >= 0) s->fd = cqe->res;
+}
+
+// Дожидается всех операций в полёте и закрывает кольцо; fd ещё не
+// выданных файлов закрываются
+static void uring_shutdown(Prefetch *pf) {
+    ring_drain(&pf->ring, uring_drained, pf);
+    ring_free(&pf->ring);
+    pf->use_uring = false;
+    for (int i = 0; i < pf->depth; ++i) {
+        Slot *s = &pf->slots[i];
+        if (s->idx >= pf->next_out && s->fd >= 0) close(s->fd);
+        slot_reset(s, -1);
+    }
+}
+
+// ---------- пул потоков ----------
+
+static void fill_slot_sync(Prefetch *pf, Slot *s) {
+    const char *name = pf->files[s->idx];
+    if (is_stdin_name(name)) return;
+
+    struct stat st;
+    if (stat(name, &st) < 0 || !prefetchable(st.st_mode)) {
+        s->deferred = true;
+        return;
+    }
+    s->fd = open(name, O_RDONLY | O_CLOEXEC);
+    if (s->fd < 0) {
+        s->open_err = errno;
+        return;
+    }
+    while (s->len < pf->slot_size) {
+        ssize_t n = read(s->fd, s->buf + s->len, pf->slot_size - s->len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            s->read_err = errno;
+            return;
+        }
+        if (n == 0) {
+            s->eof = true;
+            return;
+        }
+        s->len += (size_t)n;
+    }
+}
+
+static void *prefetch_worker(void *arg) {
+    Prefetch *pf = arg;
+    pthread_mutex_lock(&pf->mu);
+    for (;;) {
+        // вперёд не дальше depth файлов от выводимого
+        while (!pf->stop && pf->next_submit < pf->n_files &&
+               pf->next_submit - pf->next_out >= pf->depth) {
+            pthread_cond_wait(&pf->cv, &pf->mu);
+        }
+        if (pf->stop || pf->next_submit >= pf->n_files) break;
+
+        int idx = pf->next_submit++;
+        Slot *s = &pf->slots[idx % pf->depth];
+        slot_reset(s, idx);
+        pthread_mutex_unlock(&pf->mu);
+
+        fill_slot_sync(pf, s);
+
+        pthread_mutex_lock(&pf->mu);
+        s->ready = true;
+        pthread_cond_broadcast(&pf->cv);
+    }
+    pthread_mutex_unlock(&pf->mu);
+    return NULL;
+}
+
+// 0 потоков — mu и cv не инициализированы
+static bool threads_start(Prefetch *pf) {
+    pthread_mutex_init(&pf->mu, NULL);
+    pthread_cond_init(&pf->cv, NULL);
+    int want = pf->depth < PREFETCH_MAX_THREADS ? pf->depth : PREFETCH_MAX_THREADS;
+    for (; pf->n_threads < want; ++pf->n_threads) {
+        if (pthread_create(&pf->threads[pf->n_threads], NULL, prefetch_worker, pf) != 0) break;
+    }
+    if (pf->n_threads > 0) return true;
+
+    pthread_mutex_destroy(&pf->mu);
+    pthread_cond_destroy(&pf->cv);
+    return false;
+}
+
+// Кольцо сломалось посреди работы: текущий и все следующие файлы
+// читаем заново потоками, а если их не создать — синхронно в prefetch_next
+static void uring_fallback(Prefetch *pf) {
+    uring_shutdown(pf);
+    pf->next_submit = pf->next_out;
+    threads_start(pf);
+}
+
+// ---------- интерфейс ----------
+
+Prefetch *prefetch_start(char **files, int n_files, int depth, size_t slot_size) {
+    const char *mode = getenv("MYCAT_PREFETCH");   // off | threads | (по умолчанию) uring
+    if (mode && strcmp(mode, "off") == 0) return NULL;
+    if (depth > n_files) depth = n_files;
+    if (depth < 1) return NULL;
+
+    Prefetch *pf = calloc(1, sizeof(*pf));
+    if (!pf) return NULL;
+    pf->files = files;
+    pf->n_files = n_files;
+    pf->depth = depth;
+    pf->slot_size = slot_size;
+
+    pf->slots = calloc((size_t)depth, sizeof(Slot));
+    if (!pf->slots) goto fail;
+    for (int i = 0; i < depth; ++i) {
+        pf->slots[i].fd = -1;
+        pf->slots[i].buf = malloc(slot_size);
+        if (!pf->slots[i].buf) goto fail;
+    }
+
+    bool want_uring = !(mode && strcmp(mode, "threads") == 0);
+    if (want_uring && ring_init(&pf->ring, (unsigned)depth, IORING_FEAT_RW_CUR_POS) == 0) {
+        pf->use_uring = true;
+        for (; pf->next_submit < depth; ++pf->next_submit) {
+            uring_submit_file(pf, pf->next_submit);
+        }
+        return pf;
+    }
+
+    if (threads_start(pf)) return pf;
+
+fail:
+    if (pf->slots) {
+        for (int i = 0; i < depth; ++i) free(pf->slots[i].buf);
+    }
+    free(pf->slots);
+    free(pf);
+    return NULL;
+}
+
+void prefetch_next(Prefetch *pf, PrefetchItem *it) {
+    int idx = pf->next_out;
+    Slot *s = &pf->slots[idx % pf->depth];
+
+    if (pf->use_uring) {
+        while (!s->ready && uring_pump(pf) == 0) {}
+        if (!s->ready) uring_fallback(pf);
+    }
+    if (pf->use_uring) {
+        // слот готов
+    } else if (pf->n_threads > 0) {
+        pthread_mutex_lock(&pf->mu);
+        while (s->idx != idx || !s->ready) pthread_cond_wait(&pf->cv, &pf->mu);
+        pthread_mutex_unlock(&pf->mu);
+    } else {
+        // ни кольца, ни потоков: читаем сами
+        slot_reset(s, idx);
+        fill_slot_sync(pf, s);
+    }
+
+    it->name = pf->files[idx];
+    it->is_stdin = is_stdin_name(it->name);
+    it->deferred = s->deferred;
+    it->fd = s->fd;
+    it->open_err = s->open_err;
+    it->read_err = s->read_err;
+    it->data = s->buf;
+    it->len = s->len;
+    it->eof = s->eof;
+}
+
+void prefetch_release(Prefetch *pf, PrefetchItem *it) {
+    if (it->fd >= 0) close(it->fd);
+    Slot *s = &pf->slots[pf->next_out % pf->depth];
+
+    if (pf->use_uring) {
+        s->ready = false;
+        pf->next_out++;
+        if (pf->next_submit < pf->n_files) uring_submit_file(pf, pf->next_submit++);
+        return;
+    }
+    if (pf->n_threads == 0) {
+        s->ready = false;
+        pf->next_out++;
+        return;
+    }
+
+    pthread_mutex_lock(&pf->mu);
+    s->ready = false;
+    pf->next_out++;
+    pthread_cond_broadcast(&pf->cv);
+    pthread_mutex_unlock(&pf->mu);
+}
+
+void prefetch_stop(Prefetch *pf) {
+    if (pf->use_uring) {
+        // буферы нельзя освобождать, пока ядро может в них писать
+        uring_shutdown(pf);
+    } else if (pf->n_threads > 0) {
+        pthread_mutex_lock(&pf->mu);
+        pf->stop = true;
+        pthread_cond_broadcast(&pf->cv);
+        pthread_mutex_unlock(&pf->mu);
+        for (int i = 0; i < pf->n_threads; ++i) pthread_join(pf->threads[i], NULL);
+        pthread_mutex_destroy(&pf->mu);
+        pthread_cond_destroy(&pf->cv);
+    }
+
+    // файлы, до которых вывод так и не дошёл
+    for (int i = 0; i < pf->depth; ++i) {
+        Slot *s = &pf->slots[i];
+        if (s->idx >= pf->next_out && s->fd >= 0) close(s->fd);
+        free(s->buf);
+    }
+    free(pf->slots);
+    free(pf);
+}
@@ -0,0 +1,37 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Упреждающее открытие и чтение следующих файлов для mycat.
+// Пока выводится текущий файл, для следующих depth файлов уже идут
+// open и read (через io_uring, а если он недоступен — пулом потоков).
+// Заранее открываются только обычные файлы. Файлы отдаются строго в
+// порядке аргументов.
+typedef struct Prefetch Prefetch;
+
+typedef struct {
+    const char *name;
+    bool is_stdin;      // "-": ничего не читали, вызывающий читает сам
+    bool deferred;      // не обычный файл (или stat не удался): открывает и читает вызывающий
+    int fd;             // -1, если открыть не удалось
+    int open_err;       // errno открытия
+    int read_err;       // errno чтения (0 — без ошибок)
+    const char *data;   // уже прочитанное начало файла
+    size_t len;
+    bool eof;           // файл прочитан целиком; иначе дочитывать с текущей позиции fd
+} PrefetchItem;
+
+// NULL — упреждение выключено (MYCAT_PREFETCH=off) или не хватило ресурсов
+Prefetch *prefetch_start(char **files, int n_files, int depth, size_t slot_size);
+
+// Следующий по порядку файл; ждёт, пока он будет готов
+void prefetch_next(Prefetch *pf, PrefetchItem *it);
+
+// Закрывает файл и отдаёт слот под следующий по очереди
+void prefetch_release(Prefetch *pf, PrefetchItem *it);
+
+void prefetch_stop(Prefetch *pf);
+
+#endif
@@ -0,0 +1,290 @@
+#define _GNU_SOURCE
+
+#include "search.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+// Сколько неудачных сверок терпим сверх четверти пройденного пути,
+// прежде чем считать вход патологическим (aaaa...ab и т.п.)
+#define BAD_VERIFY_SLACK 64
+
+// Квадратичный случай отдаём линейному Two-Way из libc
+static bool too_many_bad(size_t *bad, const char *h, const char *start) {
+    return ++*bad > (size_t)(h - start) / 4 + BAD_VERIFY_SLACK;
+}
+
+static inline unsigned char ascii_lower(unsigned char c) {
+    return (unsigned char)((unsigned)(c - 'A') < 26u ? c | 0x20 : c);
+}
+
+static bool eq_nocase(const unsigned char *a, const unsigned char *b, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        if (ascii_lower(a[i]) != ascii_lower(b[i])) return false;
+    }
+    return true;
+}
+
+// Сверка середины кандидата: первый и последний байт уже совпали
+static inline bool verify_middle(const Searcher *s, const char *cand) {
+    if (s->len <= 2) return true;
+    const unsigned char *c = (const unsigned char *)cand + 1;
+    if (s->nocase) return eq_nocase(c, s->pat + 1, s->len - 2);
+    return memcmp(c, s->pat + 1, s->len - 2) == 0;
+}
+
+// memmem без учёта регистра в libc нет — Кнут-Моррис-Пратт со свёрткой
+static const char *find_kmp_nocase(const Searcher *s, const char *p, const char *end) {
+    size_t m = s->len;
+    size_t *fail = malloc(m * sizeof(size_t));
+    if (!fail) {
+        for (const char *h = p; (size_t)(end - h) >= m; ++h) {
+            if (eq_nocase((const unsigned char *)h, s->pat, m)) return h;
+        }
+        return NULL;
+    }
+    fail[0] = 0;
+    for (size_t i = 1, k = 0; i < m; ++i) {
+        while (k > 0 && ascii_lower(s->pat[i]) != ascii_lower(s->pat[k])) k = fail[k - 1];
+        if (ascii_lower(s->pat[i]) == ascii_lower(s->pat[k])) k++;
+        fail[i] = k;
+    }
+    const char *found = NULL;
+    size_t k = 0;
+    for (const char *h = p; h < end; ++h) {
+        unsigned char c = ascii_lower((unsigned char)*h);
+        while (k > 0 && c != ascii_lower(s->pat[k])) k = fail[k - 1];
+        if (c == ascii_lower(s->pat[k]) && ++k == m) {
+            found = h - m + 1;
+            break;
+        }
+    }
+    free(fail);
+    return found;
+}
+
+// Линейный запасной путь для патологического входа
+static const char *find_fallback(const Searcher *s, const char *p, const char *end) {
+    if (s->nocase) return find_kmp_nocase(s, p, end);
+    return memmem(p, (size_t)(end - p), s->pat, s->len);
+}
+
+static const char *find_bmh(const Searcher *s, const char *p, const char *end) {
+    size_t m = s->len;
+    if (m == 0) return p;
+    if ((size_t)(end - p) < m) return NULL;
+    if (m == 1) {
+        if (!s->first_or) return memchr(p, s->first, (size_t)(end - p));
+        for (const char *h = p; h < end; ++h) {
+            if (((unsigned char)*h | 0x20) == s->first) return h;
+        }
+        return NULL;
+    }
+
+    const unsigned char *h = (const unsigned char *)p;
+    const unsigned char *last = (const unsigned char *)end - m;
+    size_t bad = 0;
+
+    while (h <= last) {
+        unsigned char c = h[m - 1];
+        if ((c | s->last_or) == s->last) {
+            if (s->nocase ? eq_nocase(h, s->pat, m - 1) : memcmp(h, s->pat, m - 1) == 0) {
+                return (const char *)h;
+            }
+            if (too_many_bad(&bad, (const char *)h, p)) {
+                return find_fallback(s, (const char *)h, end);
+            }
+        }
+        h += s->skip[c];
+    }
+    return NULL;
+}
+
+#ifdef HAVE_X86_SIMD
+
+// Общая часть векторных ядер: mask — кандидаты (совпали первый и последний
+// байт) для позиций h..h+W-1; сверяем середину образца.
+#define VERIFY_CANDIDATES(mask)                                         \
+    while (mask) {                                                      \
+        const char *cand = h + __builtin_ctzll(mask);                   \
+        if (verify_middle(s, cand)) return cand;                        \
+        if (too_many_bad(&bad, cand, p)) {                              \
+            return find_fallback(s, cand, end);                         \
+        }                                                               \
+        mask &= mask - 1;                                               \
+    }
+
+// Однобайтовый образец с учётом регистра отдаём memchr; без учёта
+// регистра векторный цикл годится и для него (первый байт == последний)
+static inline bool vector_skip(const Searcher *s) {
+    return s->len == 0 || (s->len == 1 && !s->nocase);
+}
+
+__attribute__((target("sse2")))
+static const char *find_sse2(const Searcher *s, const char *p, const char *end) {
+    size_t m = s->len;
+    if (vector_skip(s)) return find_bmh(s, p, end);
+
+    const __m128i first = _mm_set1_epi8((char)s->first);
+    const __m128i last = _mm_set1_epi8((char)s->last);
+    const __m128i first_or = _mm_set1_epi8((char)s->first_or);
+    const __m128i last_or = _mm_set1_epi8((char)s->last_or);
+    const char *h = p;
+    size_t bad = 0;
+
+    for (; end - h >= (ptrdiff_t)(m - 1 + 16); h += 16) {
+        __m128i bf = _mm_or_si128(_mm_loadu_si128((const __m128i *)h), first_or);
+        __m128i bl = _mm_or_si128(_mm_loadu_si128((const __m128i *)(h + m - 1)), last_or);
+        uint64_t mask = (unsigned)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(first, bf), _mm_cmpeq_epi8(last, bl)));
+        VERIFY_CANDIDATES(mask)
+    }
+    return find_bmh(s, h, end);
+}
+
+__attribute__((target("avx2")))
+static const char *find_avx2(const Searcher *s, const char *p, const char *end) {
+    size_t m = s->len;
+    if (vector_skip(s)) return find_bmh(s, p, end);
+
+    const __m256i first = _mm256_set1_epi8((char)s->first);
+    const __m256i last = _mm256_set1_epi8((char)s->last);
+    const __m256i first_or = _mm256_set1_epi8((char)s->first_or);
+    const __m256i last_or = _mm256_set1_epi8((char)s->last_or);
+    const char *h = p;
+    size_t bad = 0;
+
+    for (; end - h >= (ptrdiff_t)(m - 1 + 32); h += 32) {
+        __m256i bf = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)h), first_or);
+        __m256i bl = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(h + m - 1)), last_or);
+        uint64_t mask = (unsigned)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(first, bf), _mm256_cmpeq_epi8(last, bl)));
+        VERIFY_CANDIDATES(mask)
+    }
+    return find_bmh(s, h, end);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static const char *find_avx512(const Searcher *s, const char *p, const char *end) {
+    size_t m = s->len;
+    if (vector_skip(s)) return find_bmh(s, p, end);
+
+    const __m512i first = _mm512_set1_epi8((char)s->first);
+    const __m512i last = _mm512_set1_epi8((char)s->last);
+    const __m512i first_or = _mm512_set1_epi8((char)s->first_or);
+    const __m512i last_or = _mm512_set1_epi8((char)s->last_or);
+    const char *h = p;
+    size_t bad = 0;
+
+    for (; end - h >= (ptrdiff_t)(m - 1 + 64); h += 64) {
+        __m512i bf = _mm512_or_si512(_mm512_loadu_si512((const void *)h), first_or);
+        __m512i bl = _mm512_or_si512(_mm512_loadu_si512((const void *)(h + m - 1)), last_or);
+        uint64_t mask = _mm512_cmpeq_epi8_mask(first, bf) & _mm512_cmpeq_epi8_mask(last, bl);
+        VERIFY_CANDIDATES(mask)
+    }
+    return find_bmh(s, h, end);
+}
+
+// ---------- подсчёт байта (разделителя строк) ----------
+
+__attribute__((target("sse2")))
+static size_t count_sse2(const char *p, const char *end, char c) {
+    const __m128i cv = _mm_set1_epi8(c);
+    size_t n = 0;
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        n += (size_t)__builtin_popcount((unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, cv)));
+    }
+    for (; p < end; ++p) n += *p == c;
+    return n;
+}
+
+// Совпадения копятся в байтовых счётчиках (не больше 255 итераций),
+// а затем складываются psadbw — без movemask на каждые 32 байта
+__attribute__((target("avx2")))
+static size_t count_avx2(const char *p, const char *end, char c) {
+    const __m256i cv = _mm256_set1_epi8(c);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i total = zero;
+    while (end - p >= 32) {
+        __m256i acc = zero;
+        for (int i = 0; i < 255 && end - p >= 32; ++i, p += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)p);
+            acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(v, cv));
+        }
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(acc, zero));
+    }
+    size_t n = (size_t)_mm256_extract_epi64(total, 0) + (size_t)_mm256_extract_epi64(total, 1)
+             + (size_t)_mm256_extract_epi64(total, 2) + (size_t)_mm256_extract_epi64(total, 3);
+    for (; p < end; ++p) n += *p == c;
+    return n;
+}
+
+#endif
+
+size_t count_byte(const char *p, const char *end, char c) {
+#ifdef HAVE_X86_SIMD
+    if (__builtin_cpu_supports("avx2")) return count_avx2(p, end, c);
+    if (__builtin_cpu_supports("sse2")) return count_sse2(p, end, c);
+#endif
+    size_t n = 0;
+    for (; p < end; ++p) n += *p == c;
+    return n;
+}
+
+const SearchKernel *search_kernels(void) {
+    static SearchKernel list[5];
+    static bool ready = false;
+    if (ready) return list;
+
+    int k = 0;
+    list[k++] = (SearchKernel){ "scalar", find_bmh };
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) list[k++] = (SearchKernel){ "sse2", find_sse2 };
+    if (__builtin_cpu_supports("avx2")) list[k++] = (SearchKernel){ "avx2", find_avx2 };
+    if (__builtin_cpu_supports("avx512bw")) list[k++] = (SearchKernel){ "avx512", find_avx512 };
+#endif
+    list[k] = (SearchKernel){ NULL, NULL };
+    ready = true;
+    return list;
+}
+
+// Байт для сравнения после OR с *or_mask: при nocase буквы сводятся к строчным
+static unsigned char fold_byte(unsigned char c, bool nocase, unsigned char *or_mask) {
+    unsigned char lc = ascii_lower(c);
+    *or_mask = nocase && (unsigned)(lc - 'a') < 26u ? 0x20 : 0;
+    return *or_mask ? lc : c;
+}
+
+void searcher_init(Searcher *s, const char *pat, size_t len, bool nocase) {
+    s->pat = (const unsigned char *)pat;
+    s->len = len;
+    s->nocase = nocase;
+    s->first = s->last = 0;
+    s->first_or = s->last_or = 0;
+    if (len > 0) {
+        s->first = fold_byte(s->pat[0], nocase, &s->first_or);
+        s->last = fold_byte(s->pat[len - 1], nocase, &s->last_or);
+    }
+    for (size_t c = 0; c < 256; ++c) s->skip[c] = len;
+    // последний символ образца в таблицу не входит: иначе сдвиг был бы 0
+    for (size_t i = 0; i + 1 < len; ++i) {
+        unsigned char c = s->pat[i];
+        s->skip[c] = len - 1 - i;
+        if (nocase && (unsigned)(ascii_lower(c) - 'a') < 26u) {
+            s->skip[ascii_lower(c)] = s->skip[ascii_lower(c) ^ 0x20] = len - 1 - i;
+        }
+    }
+
+    const SearchKernel *k = search_kernels();
+    while (k[1].fn) ++k;
+    s->find = k->fn;
+}
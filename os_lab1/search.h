@@ -0,0 +1,49 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct Searcher Searcher;
+
+// Ядро поиска: первое вхождение образца в [p, end) или NULL
+typedef const char *(*search_kernel_fn)(const Searcher *s, const char *p, const char *end);
+
+// Поиск фиксированной подстроки в большом блоке. Векторные ядра отсеивают
+// кандидатов по первому и последнему байту образца сразу для 16/32/64
+// позиций и сверяют их memcmp; скалярное ядро — Boyer-Moore-Horspool.
+// Таблица сдвигов и выбор ядра делаются один раз на образец.
+//
+// Без учёта регистра (nocase, только ASCII) вход не копируется: перед
+// сравнением с первым и последним байтом образца векторы ORятся с 0x20,
+// если этот байт — буква, а кандидаты сверяются со свёрткой регистра.
+struct Searcher {
+    const unsigned char *pat;
+    size_t len;
+    bool nocase;
+    unsigned char first, last;          // первый/последний байт (строчный при nocase)
+    unsigned char first_or, last_or;    // 0x20 для букв при nocase, иначе 0
+    search_kernel_fn find;
+    size_t skip[256];
+};
+
+typedef struct {
+    const char *name;
+    search_kernel_fn fn;
+} SearchKernel;
+
+// Ядра, которые поддерживает этот процессор, от простого к лучшему;
+// список заканчивается { NULL, NULL }
+const SearchKernel *search_kernels(void);
+
+// Выбирает лучшее доступное ядро; nocase — сравнение без учёта регистра ASCII
+void searcher_init(Searcher *s, const char *pat, size_t len, bool nocase);
+
+// Число байтов c в [p, end): номера строк для -n (векторный подсчёт)
+size_t count_byte(const char *p, const char *end, char c);
+
+static inline const char *searcher_find(const Searcher *s, const char *p, const char *end) {
+    return s->find(s, p, end);
+}
+
+#endif
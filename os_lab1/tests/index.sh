@@ -0,0 +1,33 @@
+#!/bin/sh
+# Проверка --index: режимы, которым нужны файлы без совпадений (-v, -c),
+# должны видеть те же файлы, что и обычный -r
+# Запуск: tests/index.sh [ПУТЬ_К_MYGREP]
+MYGREP=${1:-./mygrep}
+DIR=$(mktemp -d) || exit 2
+trap 'rm -rf "$DIR"' EXIT
+
+printf 'foo bar\n' > "$DIR/a"
+printf 'nothing\n' > "$DIR/b"
+"$MYGREP" --build-index="$DIR" || exit 2
+
+fail=0
+check() {   # check ОПИСАНИЕ ОЖИДАЕМОЕ АРГУМЕНТЫ...
+    name=$1 want=$2
+    shift 2
+    got=$("$MYGREP" "$@" | sort)
+    if [ "$got" = "$want" ]; then
+        echo "ok   $name"
+    else
+        echo "FAIL $name"
+        echo "  expected: $want"
+        echo "  got:      $got"
+        fail=1
+    fi
+}
+
+check "--index"    "$DIR/a:foo bar"              --index="$DIR" foo
+check "--index -v" "$DIR/b:nothing"              --index="$DIR" -v foo
+check "-r -v"      "$DIR/b:nothing"              -r -v foo "$DIR"
+check "--index -c" "$DIR/a:1
+$DIR/b:0"                                        --index="$DIR" -c foo
+exit $fail
@@ -0,0 +1,748 @@
+#define _GNU_SOURCE
+#include "trigram.h"
+#include "input.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define TINDEX_MAGIC "MGTRIGR1"
+#define TINDEX_TMP   ".mygrep.idx.tmp"
+#define TRI_SPACE    (1u << 24)
+
+#define FILE_UNREADABLE 1u      // при построении не прочитался: смотреть всегда
+
+// Раскладка файла: заголовок, IdxFile[n_files] (по возрастанию пути),
+// IdxDir[n_dirs], IdxTri[n_tris] (по возрастанию триграммы), списки,
+// имена. Пути — относительно каталога, без завершающего нуля.
+typedef struct {
+    char magic[8];
+    uint32_t n_files, n_dirs, n_tris, reserved;
+    uint64_t files_off, dirs_off, tris_off, post_off, names_off, total;
+} IdxHeader;
+
+typedef struct {
+    uint64_t name_off;
+    uint32_t name_len;
+    uint32_t flags;
+    int64_t mtime_ns;
+    uint64_t size;
+} IdxFile;
+
+// Каталоги нужны, чтобы заметить новые файлы: изменился mtime — перечитываем
+typedef struct {
+    uint64_t name_off;
+    uint32_t name_len;
+    uint32_t reserved;
+    int64_t mtime_ns;
+} IdxDir;
+
+typedef struct {
+    uint32_t tri;
+    uint32_t len;           // байт в списке
+    uint64_t off;           // от начала списков
+} IdxTri;
+
+static inline uint8_t fold(uint8_t c) {
+    return (uint8_t)((unsigned)(c - 'A') < 26u ? c | 0x20 : c);
+}
+
+static int64_t mtime_ns(const struct stat *st) {
+    return (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+}
+
+bool tindex_is_index_name(const char *name) {
+    return strcmp(name, TINDEX_NAME) == 0 || strcmp(name, TINDEX_TMP) == 0;
+}
+
+static char *join_path(const char *dir, const char *rel, size_t rel_len) {
+    size_t dl = strlen(dir);
+    bool slash = dl > 0 && dir[dl - 1] != '/';
+    char *s = malloc(dl + slash + rel_len + 1);
+    if (!s) return NULL;
+    memcpy(s, dir, dl);
+    if (slash) s[dl] = '/';
+    memcpy(s + dl + slash, rel, rel_len);
+    s[dl + slash + rel_len] = '\0';
+    return s;
+}
+
+static char *join_rel(const char *rel, const char *name) {
+    if (rel[0] == '\0') return strdup(name);
+    return join_path(rel, name, strlen(name));
+}
+
+// ---- Построение ----
+
+typedef struct {
+    char *rel;
+    int64_t mtime;
+    uint64_t size;
+    uint32_t flags;
+} BEnt;
+
+typedef struct {
+    BEnt *v;
+    size_t n, cap;
+} BList;
+
+static int blist_add(BList *l, char *rel, int64_t mtime) {
+    if (!rel) return -1;
+    if (l->n == l->cap) {
+        size_t cap = l->cap ? l->cap * 2 : 256;
+        BEnt *v = realloc(l->v, cap * sizeof(BEnt));
+        if (!v) {
+            free(rel);
+            return -1;
+        }
+        l->v = v;
+        l->cap = cap;
+    }
+    l->v[l->n++] = (BEnt){ rel, mtime, 0, 0 };
+    return 0;
+}
+
+static void blist_free(BList *l) {
+    for (size_t i = 0; i < l->n; ++i) free(l->v[i].rel);
+    free(l->v);
+}
+
+static int cmp_bent(const void *a, const void *b) {
+    return strcmp(((const BEnt *)a)->rel, ((const BEnt *)b)->rel);
+}
+
+// Обходит каталог rel: обычные файлы — в files, каталоги — в dirs.
+// Ссылки и прочее не индексируются (как и в -r). -1 — нет памяти
+static int collect(const char *dir, int root, const char *rel, BList *files, BList *dirs) {
+    int fd = openat(root, rel[0] ? rel : ".", O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    DIR *d = fd >= 0 ? fdopendir(fd) : NULL;
+    if (!d) {
+        fprintf(stderr, "mygrep: cannot read directory '%s/%s': %s\n", dir, rel, strerror(errno));
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+    struct stat st;
+    int64_t mt = fstat(fd, &st) == 0 ? mtime_ns(&st) : -1;
+    if (blist_add(dirs, strdup(rel), mt) < 0) {
+        closedir(d);
+        return -1;
+    }
+
+    int rc = 0;
+    struct dirent *de;
+    while (rc == 0 && (de = readdir(d)) != NULL) {
+        const char *name = de->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+        if (tindex_is_index_name(name)) continue;   // и вложенные индексы подкаталогов
+
+        unsigned char type = de->d_type;
+        if (type == DT_UNKNOWN) {
+            if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) < 0) continue;
+            type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+        }
+        if (type == DT_DIR) {
+            char *child = join_rel(rel, name);
+            rc = child ? collect(dir, root, child, files, dirs) : -1;
+            free(child);
+        } else if (type == DT_REG) {
+            rc = blist_add(files, join_rel(rel, name), 0);
+        }
+    }
+    closedir(d);
+    return rc;
+}
+
+// Список триграммы, копится по ходу построения; номера файлов растут
+typedef struct {
+    uint32_t key;           // триграмма + 1, 0 — пустая ячейка
+    uint32_t last;
+    uint32_t len, cap;
+    uint8_t *buf;
+} Post;
+
+typedef struct {
+    Post *v;
+    size_t n, cap;
+} PostTab;
+
+static size_t tri_hash(uint32_t tri) {
+    return (size_t)(tri * 0x9E3779B1u);
+}
+
+static Post *post_get(PostTab *t, uint32_t tri) {
+    if ((t->n + 1) * 2 > t->cap) {
+        size_t cap = t->cap ? t->cap * 2 : 1u << 16;
+        Post *v = calloc(cap, sizeof(Post));
+        if (!v) return NULL;
+        for (size_t i = 0; i < t->cap; ++i) {
+            if (!t->v[i].key) continue;
+            size_t j = tri_hash(t->v[i].key - 1) & (cap - 1);
+            while (v[j].key) j = (j + 1) & (cap - 1);
+            v[j] = t->v[i];
+        }
+        free(t->v);
+        t->v = v;
+        t->cap = cap;
+    }
+    size_t mask = t->cap - 1;
+    size_t i = tri_hash(tri) & mask;
+    while (t->v[i].key && t->v[i].key != tri + 1) i = (i + 1) & mask;
+    if (!t->v[i].key) {
+        t->v[i].key = tri + 1;
+        t->n++;
+    }
+    return &t->v[i];
+}
+
+static int post_add(Post *p, uint32_t id) {
+    if (p->len + 5 > p->cap) {
+        uint32_t cap = p->cap ? p->cap * 2 : 8;
+        uint8_t *buf = realloc(p->buf, cap);
+        if (!buf) return -1;
+        p->buf = buf;
+        p->cap = cap;
+    }
+    uint32_t v = p->len ? id - p->last : id;
+    while (v >= 0x80) {
+        p->buf[p->len++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p->buf[p->len++] = (uint8_t)v;
+    p->last = id;
+    return 0;
+}
+
+typedef struct {
+    uint64_t *seen;         // триграммы текущего файла, битовая карта на 2^24
+    uint32_t *touched;      // они же списком — чтобы быстро очистить карту
+    size_t cap;
+    PostTab posts;
+} Builder;
+
+// -1 — файл не прочитан (errno), -2 — нет памяти
+static int index_file(Builder *b, int root, BEnt *f, uint32_t id) {
+    int fd = openat(root, f->rel, O_RDONLY | O_NOFOLLOW | O_NOCTTY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat st;
+    Input in;
+    if (fstat(fd, &st) < 0 || input_open(&in, fd) < 0) {
+        int e = errno;
+        close(fd);
+        errno = e;
+        return -1;
+    }
+    f->mtime = mtime_ns(&st);
+    f->size = (uint64_t)st.st_size;
+
+    size_t nt = 0;
+    uint32_t t = 0;
+    int k = 0;              // байт строки в t (до 3)
+    int rc = 0;
+    const char *p;
+    size_t n;
+    int r;
+    while (rc == 0 && (r = input_next(&in, &p, &n)) > 0) {
+        for (size_t i = 0; i < n; ++i) {
+            uint8_t c = (uint8_t)p[i];
+            if (c == '\n') {
+                k = 0;      // совпадение не переходит через строку
+                continue;
+            }
+            t = ((t << 8) | fold(c)) & (TRI_SPACE - 1);
+            if (k < 3 && ++k < 3) continue;
+            if ((b->seen[t >> 6] >> (t & 63)) & 1) continue;
+            if (nt == b->cap) {
+                size_t cap = b->cap ? b->cap * 2 : 4096;
+                uint32_t *v = realloc(b->touched, cap * sizeof(uint32_t));
+                if (!v) {
+                    rc = -2;
+                    break;
+                }
+                b->touched = v;
+                b->cap = cap;
+            }
+            b->seen[t >> 6] |= 1ull << (t & 63);
+            b->touched[nt++] = t;
+        }
+    }
+    int e = errno;
+    if (rc == 0 && r < 0) rc = -1;
+    input_close(&in);
+    close(fd);
+
+    for (size_t i = 0; i < nt; ++i) {
+        uint32_t x = b->touched[i];
+        b->seen[x >> 6] &= ~(1ull << (x & 63));
+        if (rc == 0) {
+            Post *ps = post_get(&b->posts, x);
+            if (!ps || post_add(ps, id) < 0) rc = -2;
+        }
+    }
+    errno = e;
+    return rc;
+}
+
+static int cmp_post(const void *a, const void *b) {
+    uint32_t x = ((const Post *)a)->key, y = ((const Post *)b)->key;
+    return (x > y) - (x < y);
+}
+
+static int write_index(const char *dir, int root, BList *files, BList *dirs, PostTab *pt) {
+    // непустые ячейки — в начало и по порядку триграмм
+    size_t n_tris = 0;
+    for (size_t i = 0; i < pt->cap; ++i) {
+        if (!pt->v[i].key) continue;
+        Post p = pt->v[i];
+        pt->v[i] = (Post){0};
+        pt->v[n_tris++] = p;
+    }
+    qsort(pt->v, n_tris, sizeof(Post), cmp_post);
+
+    IdxHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, TINDEX_MAGIC, sizeof(h.magic));
+    h.n_files = (uint32_t)files->n;
+    h.n_dirs = (uint32_t)dirs->n;
+    h.n_tris = (uint32_t)n_tris;
+    h.files_off = sizeof(IdxHeader);
+    h.dirs_off = h.files_off + files->n * sizeof(IdxFile);
+    h.tris_off = h.dirs_off + dirs->n * sizeof(IdxDir);
+    h.post_off = h.tris_off + n_tris * sizeof(IdxTri);
+    uint64_t post_len = 0;
+    for (size_t i = 0; i < n_tris; ++i) post_len += pt->v[i].len;
+    h.names_off = h.post_off + post_len;
+    uint64_t names_len = 0;
+    for (size_t i = 0; i < files->n; ++i) names_len += strlen(files->v[i].rel);
+    for (size_t i = 0; i < dirs->n; ++i) names_len += strlen(dirs->v[i].rel);
+    h.total = h.names_off + names_len;
+
+    int fd = openat(root, TINDEX_TMP, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    FILE *f = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!f) {
+        fprintf(stderr, "mygrep: cannot create index in '%s': %s\n", dir, strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+
+    fwrite(&h, sizeof(h), 1, f);
+    uint64_t name_off = 0;
+    for (size_t i = 0; i < files->n; ++i) {
+        const BEnt *e = &files->v[i];
+        IdxFile x = { name_off, (uint32_t)strlen(e->rel), e->flags, e->mtime, e->size };
+        fwrite(&x, sizeof(x), 1, f);
+        name_off += x.name_len;
+    }
+    for (size_t i = 0; i < dirs->n; ++i) {
+        const BEnt *e = &dirs->v[i];
+        IdxDir x = { name_off, (uint32_t)strlen(e->rel), 0, e->mtime };
+        fwrite(&x, sizeof(x), 1, f);
+        name_off += x.name_len;
+    }
+    uint64_t off = 0;
+    for (size_t i = 0; i < n_tris; ++i) {
+        IdxTri x = { pt->v[i].key - 1, pt->v[i].len, off };
+        fwrite(&x, sizeof(x), 1, f);
+        off += x.len;
+    }
+    for (size_t i = 0; i < n_tris; ++i) fwrite(pt->v[i].buf, 1, pt->v[i].len, f);
+    for (size_t i = 0; i < files->n; ++i) fputs(files->v[i].rel, f);
+    for (size_t i = 0; i < dirs->n; ++i) fputs(dirs->v[i].rel, f);
+
+    bool failed = ferror(f) != 0;
+    if (fclose(f) != 0) failed = true;
+    if (failed || renameat(root, TINDEX_TMP, root, TINDEX_NAME) < 0) {
+        fprintf(stderr, "mygrep: cannot write index in '%s': %s\n", dir, strerror(errno));
+        unlinkat(root, TINDEX_TMP, 0);
+        return -1;
+    }
+    return 0;
+}
+
+int tindex_build(const char *dir) {
+    int root = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (root < 0) {
+        fprintf(stderr, "mygrep: cannot open directory '%s': %s\n", dir, strerror(errno));
+        return -1;
+    }
+
+    BList files = {0}, dirs = {0};
+    Builder b = {0};
+    int rc = collect(dir, root, "", &files, &dirs);
+    b.seen = calloc(TRI_SPACE / 64, sizeof(uint64_t));
+    if (!b.seen) rc = -1;
+    if (rc == 0 && files.n > UINT32_MAX) {
+        fprintf(stderr, "mygrep: too many files in '%s'\n", dir);
+        rc = -1;
+    }
+
+    if (rc == 0) {
+        // номера файлов — в порядке путей: так их можно искать двоичным поиском
+        qsort(files.v, files.n, sizeof(BEnt), cmp_bent);
+        qsort(dirs.v, dirs.n, sizeof(BEnt), cmp_bent);
+        for (size_t i = 0; i < files.n && rc == 0; ++i) {
+            int r = index_file(&b, root, &files.v[i], (uint32_t)i);
+            if (r == -1) {
+                fprintf(stderr, "mygrep: cannot read '%s/%s': %s\n", dir, files.v[i].rel, strerror(errno));
+                files.v[i].flags |= FILE_UNREADABLE;
+            } else if (r < 0) {
+                rc = -1;
+            }
+        }
+        if (rc < 0) fprintf(stderr, "mygrep: out of memory\n");
+    } else {
+        fprintf(stderr, "mygrep: out of memory\n");
+    }
+    if (rc == 0) rc = write_index(dir, root, &files, &dirs, &b.posts);
+
+    for (size_t i = 0; i < b.posts.cap; ++i) free(b.posts.v[i].buf);
+    free(b.posts.v);
+    free(b.seen);
+    free(b.touched);
+    blist_free(&files);
+    blist_free(&dirs);
+    close(root);
+    return rc;
+}
+
+// ---- Поиск по индексу ----
+
+struct TIndex {
+    char *dir;
+    int root;
+    const uint8_t *map;
+    size_t len;
+    const IdxHeader *h;
+    const IdxFile *files;
+    const IdxDir *dirs;
+    const IdxTri *tris;
+    const uint8_t *post;
+    const char *names;
+};
+
+static bool region_ok(uint64_t off, uint64_t count, size_t elem, uint64_t limit) {
+    return off <= limit && count <= (limit - off) / elem;
+}
+
+static bool index_valid(const TIndex *ix) {
+    const IdxHeader *h = ix->h;
+    if (memcmp(h->magic, TINDEX_MAGIC, sizeof(h->magic)) != 0 || h->total != ix->len) return false;
+    if (h->files_off % 8 || h->dirs_off % 8 || h->tris_off % 8) return false;
+    if (!region_ok(h->files_off, h->n_files, sizeof(IdxFile), h->dirs_off) ||
+        !region_ok(h->dirs_off, h->n_dirs, sizeof(IdxDir), h->tris_off) ||
+        !region_ok(h->tris_off, h->n_tris, sizeof(IdxTri), h->post_off) ||
+        h->post_off > h->names_off || h->names_off > h->total)
+        return false;
+
+    uint64_t post_len = h->names_off - h->post_off, names_len = h->total - h->names_off;
+    for (uint32_t i = 0; i < h->n_tris; ++i) {
+        if (ix->tris[i].off > post_len || ix->tris[i].len > post_len - ix->tris[i].off) return false;
+    }
+    for (uint32_t i = 0; i < h->n_files; ++i) {
+        if (ix->files[i].name_off > names_len || ix->files[i].name_len > names_len - ix->files[i].name_off)
+            return false;
+    }
+    for (uint32_t i = 0; i < h->n_dirs; ++i) {
+        if (ix->dirs[i].name_off > names_len || ix->dirs[i].name_len > names_len - ix->dirs[i].name_off)
+            return false;
+    }
+    return true;
+}
+
+TIndex *tindex_open(const char *dir) {
+    TIndex *ix = calloc(1, sizeof(*ix));
+    if (!ix) return NULL;
+    ix->root = -1;
+    ix->dir = strdup(dir);
+    if (!ix->dir) goto fail;
+    ix->root = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (ix->root < 0) goto fail;
+
+    int fd = openat(ix->root, TINDEX_NAME, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) goto fail;
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        goto fail;
+    }
+    if ((size_t)st.st_size < sizeof(IdxHeader)) {
+        close(fd);
+        errno = EINVAL;
+        goto fail;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) goto fail;
+    ix->map = map;
+    ix->len = (size_t)st.st_size;
+
+    ix->h = (const IdxHeader *)ix->map;
+    ix->files = (const IdxFile *)(ix->map + ix->h->files_off);
+    ix->dirs = (const IdxDir *)(ix->map + ix->h->dirs_off);
+    ix->tris = (const IdxTri *)(ix->map + ix->h->tris_off);
+    ix->post = ix->map + ix->h->post_off;
+    ix->names = (const char *)ix->map + ix->h->names_off;
+    if (!index_valid(ix)) {
+        errno = EINVAL;
+        goto fail;
+    }
+    return ix;
+
+fail:;
+    int e = errno;
+    tindex_close(ix);
+    errno = e;
+    return NULL;
+}
+
+void tindex_close(TIndex *ix) {
+    if (!ix) return;
+    if (ix->map) munmap((void *)ix->map, ix->len);
+    if (ix->root >= 0) close(ix->root);
+    free(ix->dir);
+    free(ix);
+}
+
+static const IdxTri *find_tri(const TIndex *ix, uint32_t tri) {
+    size_t lo = 0, hi = ix->h->n_tris;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (ix->tris[mid].tri < tri) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < ix->h->n_tris && ix->tris[lo].tri == tri ? &ix->tris[lo] : NULL;
+}
+
+// Список триграммы -> возрастающие номера файлов (не больше n_files)
+static size_t decode(const TIndex *ix, const IdxTri *t, uint32_t *ids) {
+    const uint8_t *p = ix->post + t->off, *end = p + t->len;
+    uint32_t id = 0;
+    size_t n = 0;
+    while (p < end && n < ix->h->n_files) {
+        uint32_t v = 0;
+        for (int shift = 0; p < end && shift < 35; shift += 7) {
+            uint8_t b = *p++;
+            v |= (uint32_t)(b & 0x7f) << shift;
+            if (!(b & 0x80)) break;
+        }
+        id = n ? id + v : v;
+        if (id >= ix->h->n_files) break;    // повреждённый список
+        ids[n++] = id;
+    }
+    return n;
+}
+
+static size_t intersect(uint32_t *a, size_t na, const uint32_t *b, size_t nb) {
+    size_t i = 0, j = 0, k = 0;
+    while (i < na && j < nb) {
+        if (a[i] < b[j]) i++;
+        else if (a[i] > b[j]) j++;
+        else a[k++] = a[i++], j++;
+    }
+    return k;
+}
+
+static int cmp_tri_len(const void *a, const void *b) {
+    uint32_t x = (*(const IdxTri *const *)a)->len, y = (*(const IdxTri *const *)b)->len;
+    return (x > y) - (x < y);
+}
+
+// Отмечает файлы, где есть все триграммы подстроки; начинаем с самого
+// короткого списка, чтобы пересечение быстрее сужалось
+static int mark_candidates(const TIndex *ix, const char *lit, size_t len, uint8_t *cand,
+                           uint32_t *a, uint32_t *b) {
+    const IdxTri **ts = malloc((len ? len : 1) * sizeof(*ts));
+    if (!ts) return -1;
+    size_t nt = 0;
+    uint32_t t = 0;
+    int k = 0;
+    for (size_t i = 0; i < len; ++i) {
+        uint8_t c = (uint8_t)lit[i];
+        if (c == '\n') {
+            k = 0;
+            continue;
+        }
+        t = ((t << 8) | fold(c)) & (TRI_SPACE - 1);
+        if (k < 3 && ++k < 3) continue;
+        const IdxTri *x = find_tri(ix, t);
+        if (!x) {
+            free(ts);   // триграммы нет ни в одном файле
+            return 0;
+        }
+        ts[nt++] = x;
+    }
+    if (nt == 0) {
+        memset(cand, 1, ix->h->n_files);
+        free(ts);
+        return 0;
+    }
+
+    qsort(ts, nt, sizeof(*ts), cmp_tri_len);
+    size_t n = decode(ix, ts[0], a);
+    for (size_t i = 1; i < nt && n > 0; ++i) n = intersect(a, n, b, decode(ix, ts[i], b));
+    for (size_t i = 0; i < n; ++i) cand[a[i]] = 1;
+    free(ts);
+    return 0;
+}
+
+typedef struct {
+    char **v;
+    size_t n, cap;
+} PathList;
+
+static int paths_add(PathList *l, const char *dir, const char *rel, size_t len) {
+    if (l->n == l->cap) {
+        size_t cap = l->cap ? l->cap * 2 : 64;
+        char **v = realloc(l->v, cap * sizeof(char *));
+        if (!v) return -1;
+        l->v = v;
+        l->cap = cap;
+    }
+    char *s = join_path(dir, rel, len);
+    if (!s) return -1;
+    l->v[l->n++] = s;
+    return 0;
+}
+
+static int cmp_name(const char *names, uint64_t off, uint32_t len, const char *key, size_t klen) {
+    int c = memcmp(names + off, key, len < klen ? len : klen);
+    if (c) return c;
+    return (len > klen) - (len < klen);
+}
+
+static bool known_file(const TIndex *ix, const char *rel) {
+    size_t klen = strlen(rel), lo = 0, hi = ix->h->n_files;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int c = cmp_name(ix->names, ix->files[mid].name_off, ix->files[mid].name_len, rel, klen);
+        if (c == 0) return true;
+        if (c < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return false;
+}
+
+static bool known_dir(const TIndex *ix, const char *rel) {
+    size_t klen = strlen(rel), lo = 0, hi = ix->h->n_dirs;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int c = cmp_name(ix->names, ix->dirs[mid].name_off, ix->dirs[mid].name_len, rel, klen);
+        if (c == 0) return true;
+        if (c < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return false;
+}
+
+// Каталог изменился после построения: добавляем файлы, которых нет в
+// индексе (all — весь каталог новый, добавляем всё)
+static int add_new(const TIndex *ix, const char *rel, bool all, PathList *out) {
+    int fd = openat(ix->root, rel[0] ? rel : ".", O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    DIR *d = fd >= 0 ? fdopendir(fd) : NULL;
+    if (!d) {
+        if (fd >= 0) close(fd);
+        return 0;       // каталог исчез — искать в нём нечего
+    }
+    int rc = 0;
+    struct dirent *de;
+    while (rc == 0 && (de = readdir(d)) != NULL) {
+        const char *name = de->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+        if (tindex_is_index_name(name)) continue;   // и вложенные индексы подкаталогов
+
+        unsigned char type = de->d_type;
+        if (type == DT_UNKNOWN) {
+            struct stat st;
+            if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) < 0) continue;
+            type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+        }
+        if (type != DT_REG && type != DT_DIR) continue;
+        char *child = join_rel(rel, name);
+        if (!child) {
+            rc = -1;
+            break;
+        }
+        if (type == DT_REG) {
+            if (all || !known_file(ix, child)) rc = paths_add(out, ix->dir, child, strlen(child));
+        } else if (all || !known_dir(ix, child)) {
+            rc = add_new(ix, child, true, out);
+        }
+        free(child);
+    }
+    closedir(d);
+    return rc;
+}
+
+int tindex_select(const TIndex *ix, const char *const *lits, const size_t *lens, size_t n,
+                  char ***files, size_t *n_files) {
+    uint32_t nf = ix->h->n_files;
+    PathList out = {0};
+    uint8_t *cand = calloc(nf ? nf : 1, 1);
+    uint32_t *a = malloc((nf ? nf : 1) * sizeof(uint32_t));
+    uint32_t *b = malloc((nf ? nf : 1) * sizeof(uint32_t));
+    char *rel = malloc(PATH_MAX);
+    int rc = cand && a && b && rel ? 0 : -1;
+
+    if (rc == 0) {
+        bool all = n == 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (lens[i] < 3) all = true;    // короткий образец индекс не сузит
+        }
+        if (all) memset(cand, 1, nf);
+        for (size_t i = 0; i < n && !all && rc == 0; ++i) rc = mark_candidates(ix, lits[i], lens[i], cand, a, b);
+    }
+
+    for (uint32_t i = 0; i < nf && rc == 0; ++i) {
+        const IdxFile *f = &ix->files[i];
+        const char *name = ix->names + f->name_off;
+        bool stale = true;
+        if (f->name_len < PATH_MAX) {
+            memcpy(rel, name, f->name_len);
+            rel[f->name_len] = '\0';
+            struct stat st;
+            if (fstatat(ix->root, rel, &st, AT_SYMLINK_NOFOLLOW) < 0) {
+                if (errno == ENOENT) continue;      // файл удалён
+            } else {
+                if (!S_ISREG(st.st_mode)) continue;
+                stale = (f->flags & FILE_UNREADABLE) || mtime_ns(&st) != f->mtime_ns ||
+                        (uint64_t)st.st_size != f->size;
+            }
+        }
+        if (cand[i] || stale) rc = paths_add(&out, ix->dir, name, f->name_len);
+    }
+
+    for (uint32_t i = 0; i < ix->h->n_dirs && rc == 0; ++i) {
+        const IdxDir *d = &ix->dirs[i];
+        if (d->name_len >= PATH_MAX) continue;
+        memcpy(rel, ix->names + d->name_off, d->name_len);
+        rel[d->name_len] = '\0';
+        struct stat st;
+        if (fstatat(ix->root, rel[0] ? rel : ".", &st, AT_SYMLINK_NOFOLLOW) < 0) continue;
+        if (mtime_ns(&st) != d->mtime_ns) rc = add_new(ix, rel, false, &out);
+    }
+
+    free(cand);
+    free(a);
+    free(b);
+    free(rel);
+    if (rc < 0) {
+        tindex_free_list(out.v, out.n);
+        return -1;
+    }
+    *files = out.v;
+    *n_files = out.n;
+    return 0;
+}
+
+void tindex_free_list(char **files, size_t n) {
+    for (size_t i = 0; i < n; ++i) free(files[i]);
+    free(files);
+}
@@ -0,0 +1,35 @@
+#ifndef TRIGRAM_H
+#define TRIGRAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Триграммный индекс каталога для повторных поисков по неизменному корпусу.
+// Для каждой триграммы (три подряд идущих байта внутри строки, буквы ASCII
+// сведены к строчным) хранится возрастающий список номеров файлов, где она
+// встречается: разности соседних номеров в varint. Файл индекса лежит в
+// самом каталоге и используется прямо из mmap, без разбора.
+#define TINDEX_NAME ".mygrep.idx"
+
+typedef struct TIndex TIndex;
+
+// Имя файла индекса (или его временной копии): такие файлы не ищутся
+bool tindex_is_index_name(const char *name);
+
+// Строит DIR/.mygrep.idx; 0 — готово, -1 — ошибка (сообщение уже выведено)
+int tindex_build(const char *dir);
+
+// NULL — индекса нет или он повреждён (errno выставлен)
+TIndex *tindex_open(const char *dir);
+void tindex_close(TIndex *ix);
+
+// Файлы каталога, которые нужно просмотреть, чтобы найти строки хотя бы
+// с одной из подстрок lits (n == 0 — без ограничений): кандидаты по
+// триграммам, а также изменившиеся после построения (mtime/размер) и
+// новые файлы. Пути вида "DIR/...", освобождаются tindex_free_list.
+// -1 — не хватило памяти
+int tindex_select(const TIndex *ix, const char *const *lits, const size_t *lens, size_t n,
+                  char ***files, size_t *n_files);
+void tindex_free_list(char **files, size_t n);
+
+#endif
@@ -0,0 +1,66 @@
+#define _XOPEN_SOURCE 700
+
+#include "arena.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_MIN_BLOCK (64u << 10)     // первый блок
+#define ARENA_MAX_BLOCK (4u << 20)      // дальше блоки не растут
+
+struct ArenaBlock {
+    ArenaBlock *prev;
+    size_t size;
+    max_align_t data[];
+};
+
+void arena_init(Arena *a) {
+    memset(a, 0, sizeof(*a));
+    a->next_size = ARENA_MIN_BLOCK;
+}
+
+// Новый блок не меньше need; размер блоков растёт вдвое до ARENA_MAX_BLOCK
+static int arena_grow(Arena *a, size_t need) {
+    size_t size = a->next_size;
+    if (size < need) size = need;
+    ArenaBlock *b = malloc(sizeof(ArenaBlock) + size);
+    if (!b) return -1;
+    b->prev = a->head;
+    b->size = size;
+    a->head = b;
+    a->cur = (char *)b->data;
+    a->end = a->cur + size;
+    a->reserved += sizeof(ArenaBlock) + size;
+    if (a->next_size < ARENA_MAX_BLOCK) a->next_size *= 2;
+    return 0;
+}
+
+void *arena_alloc(Arena *a, size_t n, size_t align) {
+    uintptr_t p = ((uintptr_t)a->cur + align - 1) & ~(uintptr_t)(align - 1);
+    if (!a->head || n > (size_t)((uintptr_t)a->end - p) || p > (uintptr_t)a->end) {
+        if (arena_grow(a, n + align) < 0) return NULL;
+        p = ((uintptr_t)a->cur + align - 1) & ~(uintptr_t)(align - 1);
+    }
+    a->cur = (char *)p + n;
+    a->used += n;
+    return (void *)p;
+}
+
+char *arena_strndup(Arena *a, const char *s, size_t len) {
+    char *d = arena_alloc(a, len + 1, 1);
+    if (!d) return NULL;
+    memcpy(d, s, len);
+    d[len] = '\0';
+    return d;
+}
+
+void arena_free(Arena *a) {
+    ArenaBlock *b = a->head;
+    while (b) {
+        ArenaBlock *prev = b->prev;
+        free(b);
+        b = prev;
+    }
+    arena_init(a);
+}
@@ -0,0 +1,30 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Линейный (bump) аллокатор: память выдаётся подряд из крупных блоков
+// и освобождается только вся сразу. Для имён, целей ссылок и прочих
+// данных записей каталога, которые живут ровно столько же, сколько листинг.
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct {
+    ArenaBlock *head;       // текущий блок, предыдущие — по цепочке
+    char *cur, *end;        // свободное место в текущем блоке
+    size_t next_size;       // размер следующего блока
+    size_t used;            // выдано байт (для измерений)
+    size_t reserved;        // занято блоками у системы
+} Arena;
+
+void arena_init(Arena *a);
+
+// NULL — не хватило памяти; align — степень двойки
+void *arena_alloc(Arena *a, size_t n, size_t align);
+
+// Копия s[0..len) с завершающим '\0'
+char *arena_strndup(Arena *a, const char *s, size_t len);
+
+// Возвращает всю память; после arena_free арена снова пуста и годна к работе
+void arena_free(Arena *a);
+
+#endif
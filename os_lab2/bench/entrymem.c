@@ -0,0 +1,132 @@
+// Память и время myls на запись каталога.
+//
+//   entrymem [-n N] [-d DIR] PROG
+//
+// Создаёт в DIR N пустых файлов (каждый сотый — символическая ссылка),
+// если их там ещё нет, и запускает PROG на DIR и на пустом каталоге
+// в режимах без флагов и -l. Вывод уходит в /dev/null. Печатает время,
+// пиковый RSS и прирост RSS на запись относительно пустого каталога.
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Запускает prog [opt] dir; пиковый RSS в КиБ или -1
+static long run(const char *prog, const char *opt, const char *dir, double *wall) {
+    double t0 = now_sec();
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        int devnull = open("/dev/null", O_WRONLY);
+        if (devnull >= 0) dup2(devnull, STDOUT_FILENO);
+        if (opt) execl(prog, prog, opt, dir, (char *)NULL);
+        else execl(prog, prog, dir, (char *)NULL);
+        _exit(127);
+    }
+    struct rusage ru;
+    int status;
+    while (wait4(pid, &status, 0, &ru) < 0) {
+        if (errno != EINTR) return -1;
+    }
+    *wall = now_sec() - t0;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "entrymem: '%s' failed\n", prog);
+        return -1;
+    }
+    return ru.ru_maxrss;
+}
+
+// Заполняет dir; по маркеру .count понимает, что уже заполнено
+static int populate(const char *dir, long n) {
+    char path[4096];
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+        fprintf(stderr, "entrymem: cannot create '%s': %s\n", dir, strerror(errno));
+        return -1;
+    }
+    snprintf(path, sizeof(path), "%s/.count", dir);
+    FILE *f = fopen(path, "r");
+    long have = -1;
+    if (f) {
+        if (fscanf(f, "%ld", &have) != 1) have = -1;
+        fclose(f);
+    }
+    if (have == n) return 0;
+
+    for (long i = 0; i < n; ++i) {
+        snprintf(path, sizeof(path), "%s/entry_%08ld", dir, i);
+        int rc;
+        if (i % 100 == 99) {
+            rc = symlink("../some/link/target", path);
+        } else {
+            int fd = open(path, O_WRONLY | O_CREAT, 0644);
+            rc = fd < 0 ? -1 : close(fd);
+        }
+        if (rc < 0 && errno != EEXIST) {
+            fprintf(stderr, "entrymem: cannot create '%s': %s\n", path, strerror(errno));
+            return -1;
+        }
+    }
+    snprintf(path, sizeof(path), "%s/.count", dir);
+    f = fopen(path, "w");
+    if (!f) return -1;
+    fprintf(f, "%ld\n", n);
+    return fclose(f);
+}
+
+int main(int argc, char **argv) {
+    long n = 200000;
+    const char *dir = "bench/flat";
+    int opt;
+    while ((opt = getopt(argc, argv, "n:d:")) != -1) {
+        switch (opt) {
+            case 'n':
+                n = atol(optarg);
+                break;
+            case 'd':
+                dir = optarg;
+                break;
+            default:
+                n = -1;
+        }
+    }
+    if (argc - optind != 1 || n < 1) {
+        fprintf(stderr, "Usage: %s [-n N] [-d DIR] PROG\n", argv[0]);
+        return 2;
+    }
+    const char *prog = argv[optind];
+
+    char empty[4096];
+    snprintf(empty, sizeof(empty), "%s.empty", dir);
+    if (populate(dir, n) < 0) return 1;
+    if (mkdir(empty, 0755) < 0 && errno != EEXIST) {
+        fprintf(stderr, "entrymem: cannot create '%s': %s\n", empty, strerror(errno));
+        return 1;
+    }
+
+    static const char *const modes[] = { NULL, "-l" };
+    printf("%-6s %10s %10s %12s %14s\n", "mode", "entries", "wall_s", "max_rss_kb", "bytes/entry");
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); ++i) {
+        double wall, w0;
+        run(prog, modes[i], dir, &wall);   // прогрев кэша каталога
+        long base = run(prog, modes[i], empty, &w0);
+        long rss = run(prog, modes[i], dir, &wall);
+        if (base < 0 || rss < 0) return 1;
+        printf("%-6s %10ld %10.3f %12ld %14.1f\n", modes[i] ? modes[i] : "plain", n, wall, rss,
+               (double)(rss - base) * 1024 / (double)n);
+    }
+    return 0;
+}
@@ -0,0 +1,140 @@
+#define _GNU_SOURCE
+
+#include "idcache.h"
+
+#include <errno.h>
+#include <grp.h>
+#include <pwd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IDCACHE_INIT_SLOTS  64
+#define NSS_BUF_SIZE        (16 << 10)  // начальный буфер для getpwuid_r/getgrgid_r
+
+static void die(const char *msg) {
+    perror(msg);
+    exit(EXIT_FAILURE);
+}
+
+static size_t id_hash(unsigned id) {
+    return (size_t)(id * 0x9E3779B1u);
+}
+
+static void table_init(IdTable *t) {
+    t->slots = calloc(IDCACHE_INIT_SLOTS, sizeof(IdSlot));
+    if (!t->slots) die("calloc");
+    t->mask = IDCACHE_INIT_SLOTS - 1;
+    t->count = 0;
+}
+
+// Слот с ключом id или пустой слот, куда его вставлять
+static IdSlot *table_find(const IdTable *t, unsigned id) {
+    size_t i = id_hash(id) & t->mask;
+    while (t->slots[i].used && t->slots[i].id != id) i = (i + 1) & t->mask;
+    return &t->slots[i];
+}
+
+// Заполненность держим не выше половины
+static void table_grow(IdTable *t) {
+    IdTable old = *t;
+    t->mask = old.mask * 2 + 1;
+    t->slots = calloc(t->mask + 1, sizeof(IdSlot));
+    if (!t->slots) die("calloc");
+    for (size_t i = 0; i <= old.mask; ++i) {
+        if (old.slots[i].used) *table_find(t, old.slots[i].id) = old.slots[i];
+    }
+    free(old.slots);
+}
+
+static void table_put(IdCache *c, IdTable *t, IdSlot *s, unsigned id, const char *name, size_t len) {
+    s->used = true;
+    s->id = id;
+    s->v.name = arena_strndup(&c->names, name, len);
+    if (!s->v.name) die("malloc");
+    s->v.len = (int)len;
+    if (++t->count * 2 > t->mask + 1) table_grow(t);
+}
+
+void idcache_init(IdCache *c) {
+    table_init(&c->users);
+    table_init(&c->groups);
+    arena_init(&c->names);
+}
+
+// Разбирает файл вида name:x:id:... и заносит id, которых ещё нет
+static void preload_file(IdCache *c, IdTable *t, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return;
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t n;
+    while ((n = getline(&line, &cap, f)) > 0) {
+        char *name_end = memchr(line, ':', (size_t)n);
+        if (!name_end || name_end == line) continue;
+        char *id_field = strchr(name_end + 1, ':');
+        if (!id_field) continue;
+        char *end;
+        errno = 0;
+        unsigned long id = strtoul(id_field + 1, &end, 10);
+        if (errno || end == id_field + 1 || *end != ':' || id > 0xffffffffUL) continue;
+        IdSlot *s = table_find(t, (unsigned)id);
+        if (!s->used) table_put(c, t, s, (unsigned)id, line, (size_t)(name_end - line));
+    }
+    free(line);
+    fclose(f);
+}
+
+void idcache_preload(IdCache *c) {
+    preload_file(c, &c->users, "/etc/passwd");
+    preload_file(c, &c->groups, "/etc/group");
+}
+
+// Промах: спрашиваем NSS; буфер растёт, пока не хватит (ERANGE)
+static IdName lookup(IdCache *c, IdTable *t, unsigned id, bool user) {
+    IdSlot *s = table_find(t, id);
+    if (s->used) return s->v;
+
+    size_t cap = NSS_BUF_SIZE;
+    char *buf = NULL;
+    const char *name = NULL;
+    int rc;
+    do {
+        char *tmp = realloc(buf, cap);
+        if (!tmp) die("realloc");
+        buf = tmp;
+        if (user) {
+            struct passwd pw, *res = NULL;
+            rc = getpwuid_r((uid_t)id, &pw, buf, cap, &res);
+            if (rc == 0 && res) name = res->pw_name;
+        } else {
+            struct group gr, *res = NULL;
+            rc = getgrgid_r((gid_t)id, &gr, buf, cap, &res);
+            if (rc == 0 && res) name = res->gr_name;
+        }
+        cap *= 2;
+    } while (rc == ERANGE);
+
+    char num[16];
+    if (!name) {
+        snprintf(num, sizeof(num), "%u", id);
+        name = num;
+    }
+    table_put(c, t, s, id, name, strlen(name));
+    free(buf);
+    return table_find(t, id)->v;   // таблица могла вырасти
+}
+
+IdName idcache_user(IdCache *c, uid_t uid) {
+    return lookup(c, &c->users, (unsigned)uid, true);
+}
+
+IdName idcache_group(IdCache *c, gid_t gid) {
+    return lookup(c, &c->groups, (unsigned)gid, false);
+}
+
+void idcache_free(IdCache *c) {
+    free(c->users.slots);
+    free(c->groups.slots);
+    arena_free(&c->names);
+}
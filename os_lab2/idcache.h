@@ -0,0 +1,47 @@
+#ifndef IDCACHE_H
+#define IDCACHE_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "arena.h"
+
+// Имя пользователя/группы и его длина
+typedef struct {
+    const char *name;
+    int len;
+} IdName;
+
+typedef struct {
+    unsigned id;
+    bool used;
+    IdName v;
+} IdSlot;
+
+// Открытая адресация с линейным пробированием, ключ — uid или gid
+typedef struct {
+    IdSlot *slots;
+    size_t mask;            // размер таблицы - 1 (степень двойки)
+    size_t count;
+} IdTable;
+
+// Кэш uid/gid -> имя для -l: каждое имя ищется через NSS (getpwuid_r/getgrgid_r)
+// не больше одного раза. Не потокобезопасен: по экземпляру на поток.
+typedef struct {
+    IdTable users, groups;
+    Arena names;
+} IdCache;
+
+void idcache_init(IdCache *c);
+
+// Разом заносит всех из /etc/passwd и /etc/group (первое вхождение id
+// побеждает, как у getpwuid). Имеет смысл, когда NSS смотрит сначала в files.
+void idcache_preload(IdCache *c);
+
+// Имя, а если его нет — id числом
+IdName idcache_user(IdCache *c, uid_t uid);
+IdName idcache_group(IdCache *c, gid_t gid);
+
+void idcache_free(IdCache *c);
+
+#endif
@@ -1,4 +1,4 @@
-#define _XOPEN_SOURCE 700
+#define _GNU_SOURCE
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -8,24 +8,65 @@
 #include <dirent.h>
 #include <sys/types.h>
 #include <sys/stat.h>
-#include <pwd.h>
-#include <grp.h>
 #include <time.h>
 #include <errno.h>
 #include <limits.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "arena.h"
+#include "idcache.h"
+#include "pool.h"
+#include "statbatch.h"
+#include "writer.h"
 
 #define COLOR_BLUE   "\033[34m"
 #define COLOR_GREEN  "\033[32m"
 #define COLOR_CYAN   "\033[36m"
 #define COLOR_RESET  "\033[0m"
 
+// Поля statx, нужные выбранному режиму: для цвета хватает типа и прав
+#define STATX_COLOR  (STATX_TYPE | STATX_MODE)
+#define STAT_BATCH   1024     // записей на один пакет statx
+
+#define STATX_LONG   (STATX_COLOR | STATX_NLINK | STATX_UID | STATX_GID | \
+                      STATX_SIZE | STATX_BLOCKS | STATX_MTIME)
+
+// -R: потоков обхода по умолчанию не больше этого; сколько байт готового
+// вывода может ждать выдачи, прежде чем рабочие перестанут брать каталоги
+#define REC_MAX_JOBS   8
+#define REC_BUF_LIMIT  ((size_t)32 << 20)
+
+#define STREAM_BUF     (256 << 10)   // буфер getdents64 и вывода для -U/-f
+
 typedef struct {
-    char *name;              // имя для вывода
-    char *fullpath;          // путь для stat()
-    struct stat st;
-    int is_symlink;
-    char link_target[PATH_MAX];
-    ssize_t link_len;
+    bool all;       // -a
+    bool longfmt;   // -l
+    bool color;     // stdout — терминал
+    bool recursive; // -R
+    bool unsorted;  // -U/-f: порядок каталога
+    int jobs;       // потоков обхода для -R
+    IdCache *ids;   // имена владельцев для -l
+    StatBatch *stats;   // пакетный statx для записей каталогов
+} Opts;
+
+// Поля для -l: в коротком режиме не заводятся вовсе
+typedef struct {
+    nlink_t nlink;
+    uid_t uid;
+    gid_t gid;
+    off_t size;
+    blkcnt_t blocks;
+    time_t mtime;
+    const char *link;        // цель символической ссылки (в арене) или NULL
+} EntryLong;
+
+// Запись каталога: имя и всё остальное живут в арене листинга
+typedef struct {
+    const char *name;        // имя для вывода
+    const EntryLong *lng;    // NULL без -l
+    mode_t mode;
 } Entry;
 
 static void die(const char *msg) {
@@ -66,9 +107,11 @@ static void mode_to_string(mode_t mode, char *buf) {
     buf[10] = '\0';
 }
 
-static const char *color_for_entry(const Entry *e) {
-    mode_t m = e->st.st_mode;
-    if (e->is_symlink) {
+static const char *color_for_entry(const Entry *e, const Opts *o) {
+    mode_t m = e->mode;
+    if (!o->color) {
+        return NULL;
+    } else if (S_ISLNK(m)) {
         return COLOR_CYAN;
     } else if (S_ISDIR(m)) {
         return COLOR_BLUE;
@@ -78,12 +121,12 @@ static const char *color_for_entry(const Entry *e) {
     return NULL; // обычный файл — без цвета
 }
 
-static void print_entry_short(const Entry *e) {
-    const char *color = color_for_entry(e);
+static void print_entry_short(FILE *out, const Entry *e, const Opts *o) {
+    const char *color = color_for_entry(e, o);
     if (color) {
-        printf("%s%s%s\n", color, e->name, COLOR_RESET);
+        fprintf(out, "%s%s%s\n", color, e->name, COLOR_RESET);
     } else {
-        printf("%s\n", e->name);
+        fprintf(out, "%s\n", e->name);
     }
 }
 
@@ -95,7 +138,7 @@ typedef struct {
     long long total_blocks;
 } Widths;
 
-static void compute_widths(Entry *entries, size_t n, Widths *w) {
+static void compute_widths(Entry *entries, size_t n, Widths *w, const Opts *o) {
     w->w_links = 0;
     w->w_user = 0;
     w->w_group = 0;
@@ -105,106 +148,145 @@ static void compute_widths(Entry *entries, size_t n, Widths *w) {
     char buf[64];
 
     for (size_t i = 0; i < n; ++i) {
-        struct stat *st = &entries[i].st;
+        const EntryLong *st = entries[i].lng;
 
         // links
-        int len = snprintf(buf, sizeof(buf), "%lu", (unsigned long)st->st_nlink);
+        int len = snprintf(buf, sizeof(buf), "%lu", (unsigned long)st->nlink);
         if (len > w->w_links) w->w_links = len;
 
-        // user
-        const char *uname = NULL;
-        struct passwd *pw = getpwuid(st->st_uid);
-        if (pw) uname = pw->pw_name;
-        else {
-            snprintf(buf, sizeof(buf), "%u", st->st_uid);
-            uname = buf;
-        }
-        int luser = (int)strlen(uname);
+        // user, group: длины имён уже посчитаны в кэше
+        int luser = idcache_user(o->ids, st->uid).len;
         if (luser > w->w_user) w->w_user = luser;
 
-        // group
-        const char *gname = NULL;
-        struct group *gr = getgrgid(st->st_gid);
-        if (gr) gname = gr->gr_name;
-        else {
-            snprintf(buf, sizeof(buf), "%u", st->st_gid);
-            gname = buf;
-        }
-        int lgroup = (int)strlen(gname);
+        int lgroup = idcache_group(o->ids, st->gid).len;
         if (lgroup > w->w_group) w->w_group = lgroup;
 
         // size
-        len = snprintf(buf, sizeof(buf), "%lld", (long long)st->st_size);
+        len = snprintf(buf, sizeof(buf), "%lld", (long long)st->size);
         if (len > w->w_size) w->w_size = len;
 
         // blocks (переведём в 1K-блоки из 512-байтных)
-        w->total_blocks += (long long)(st->st_blocks / 2);
+        w->total_blocks += (long long)(st->blocks / 2);
     }
 }
 
-static void print_entry_long(const Entry *e, const Widths *w) {
+static void print_entry_long(FILE *out, const Entry *e, const Widths *w, const Opts *o) {
+    const EntryLong *st = e->lng;
     char modebuf[11];
-    mode_to_string(e->st.st_mode, modebuf);
+    mode_to_string(e->mode, modebuf);
 
-    // владелец
-    char userbuf[64];
-    const char *uname = NULL;
-    struct passwd *pw = getpwuid(e->st.st_uid);
-    if (pw) uname = pw->pw_name;
-    else {
-        snprintf(userbuf, sizeof(userbuf), "%u", e->st.st_uid);
-        uname = userbuf;
-    }
-
-    // группа
-    char groupbuf[64];
-    const char *gname = NULL;
-    struct group *gr = getgrgid(e->st.st_gid);
-    if (gr) gname = gr->gr_name;
-    else {
-        snprintf(groupbuf, sizeof(groupbuf), "%u", e->st.st_gid);
-        gname = groupbuf;
-    }
+    // владелец и группа — из кэша, второй раз NSS не спрашиваем
+    const char *uname = idcache_user(o->ids, st->uid).name;
+    const char *gname = idcache_group(o->ids, st->gid).name;
 
     // время
     char timebuf[64];
     struct tm lt;
-    localtime_r(&e->st.st_mtime, &lt);
+    localtime_r(&st->mtime, &lt);
     strftime(timebuf, sizeof(timebuf), "%b %e %H:%M", &lt);
 
-    const char *color = color_for_entry(e);
+    const char *color = color_for_entry(e, o);
 
-    printf("%s %*lu %-*s %-*s %*lld %s ",
+    fprintf(out, "%s %*lu %-*s %-*s %*lld %s ",
            modebuf,
-           w->w_links, (unsigned long)e->st.st_nlink,
+           w->w_links, (unsigned long)st->nlink,
            w->w_user,  uname,
            w->w_group, gname,
-           w->w_size,  (long long)e->st.st_size,
+           w->w_size,  (long long)st->size,
            timebuf);
 
     if (color) {
-        printf("%s%s%s", color, e->name, COLOR_RESET);
+        fprintf(out, "%s%s%s", color, e->name, COLOR_RESET);
     } else {
-        printf("%s", e->name);
+        fputs(e->name, out);
     }
 
-    if (e->is_symlink && e->link_len > 0) {
-        printf(" -> %s", e->link_target);
+    if (st->link) {
+        fprintf(out, " -> %s", st->link);
     }
 
-    putchar('\n');
+    fputc('\n', out);
 }
 
-static void free_entries(Entry *entries, size_t n) {
-    for (size_t i = 0; i < n; ++i) {
-        free(entries[i].name);
-        free(entries[i].fullpath);
+// для -R тип нужен, чтобы найти подкаталоги
+static bool need_stat(unsigned char d_type, const Opts *o) {
+    return o->longfmt || (o->color && (d_type == DT_REG || d_type == DT_UNKNOWN)) ||
+           (o->recursive && d_type == DT_UNKNOWN);
+}
+
+// Переносит результат statx в e: поля -l и цель ссылки — в арене
+static void apply_stat(Entry *e, Arena *a, int dirfd, const struct statx *stx, const Opts *o) {
+    e->mode = stx->stx_mode;
+    if (!o->longfmt) return;
+
+    EntryLong *l = arena_alloc(a, sizeof(EntryLong), _Alignof(EntryLong));
+    if (!l) die("malloc");
+    l->nlink = stx->stx_nlink;
+    l->uid = stx->stx_uid;
+    l->gid = stx->stx_gid;
+    l->size = (off_t)stx->stx_size;
+    l->blocks = (blkcnt_t)stx->stx_blocks;
+    l->mtime = stx->stx_mtime.tv_sec;
+    l->link = NULL;
+    if (S_ISLNK(stx->stx_mode)) {
+        char target[PATH_MAX];
+        ssize_t r = readlinkat(dirfd, e->name, target, sizeof(target) - 1);
+        if (r >= 0) {
+            l->link = arena_strndup(a, target, (size_t)r);
+            if (!l->link) die("malloc");
+        }
     }
-    free(entries);
+    e->lng = l;
 }
 
-static void add_entry(Entry **entries, size_t *cnt, size_t *cap,
-                      const char *dirpath, const char *name) {
+// Заполняет e для записи name каталога dirfd. stat нужен только для -l и для
+// цвета обычных файлов (бит x); остальное берётся из d_type. -1 — stat не удался.
+static int fill_entry(Entry *e, Arena *a, int dirfd, const char *name,
+                      unsigned char d_type, const Opts *o) {
+    e->name = arena_strndup(a, name, strlen(name));
+    if (!e->name) die("malloc");
+    e->mode = DTTOIF(d_type);
+    e->lng = NULL;
+    if (!need_stat(d_type, o)) return 0;
+
+    struct statx stx;
+    if (stat_at(dirfd, name, o->longfmt ? STATX_LONG : STATX_COLOR, &stx) == -1) return -1;
+    apply_stat(e, a, dirfd, &stx, o);
+    return 0;
+}
+
+// Записи каталога, ждущие statx: копятся по мере readdir и уходят пакетом
+typedef struct {
+    StatReq *reqs;
+    size_t *idx;            // номер записи в entries
+    size_t n, cap;
+} Pending;
+
+// Выполняет накопленные statx. Записи, для которых stat не удался,
+// помечаются name = NULL и потом выбрасываются.
+static size_t flush_pending(Pending *p, Entry *entries, Arena *a, int dirfd,
+                            const char *dirpath, const Opts *o, FILE *err) {
+    size_t failed = 0;
+    statbatch_run(o->stats, dirfd, o->longfmt ? STATX_LONG : STATX_COLOR, p->reqs, p->n);
+    for (size_t i = 0; i < p->n; ++i) {
+        Entry *e = &entries[p->idx[i]];
+        if (p->reqs[i].err) {
+            size_t len = strlen(dirpath);
+            const char *sep = (len > 0 && dirpath[len - 1] != '/') ? "/" : "";
+            fprintf(err, "myls: cannot stat '%s%s%s': %s\n",
+                    dirpath, sep, e->name, strerror(p->reqs[i].err));
+            e->name = NULL;
+            failed++;
+        } else {
+            apply_stat(e, a, dirfd, &p->reqs[i].stx, o);
+        }
+    }
+    p->n = 0;
+    return failed;
+}
+
+static void add_entry(Entry **entries, size_t *cnt, size_t *cap, Arena *a,
+                      Pending *p, const struct dirent *de, const Opts *o) {
     if (*cnt == *cap) {
         size_t new_cap = (*cap == 0) ? 32 : (*cap * 2);
         Entry *tmp = realloc(*entries, new_cap * sizeof(Entry));
@@ -214,47 +296,195 @@ static void add_entry(Entry **entries, size_t *cnt, size_t *cap,
     }
 
     Entry *e = &(*entries)[*cnt];
-    memset(e, 0, sizeof(*e));
+    e->name = arena_strndup(a, de->d_name, strlen(de->d_name));
+    if (!e->name) die("malloc");
+    e->mode = DTTOIF(de->d_type);
+    e->lng = NULL;
+
+    if (need_stat(de->d_type, o)) {
+        if (p->n == p->cap) {
+            size_t new_cap = p->cap == 0 ? 32 : p->cap * 2;
+            StatReq *reqs = realloc(p->reqs, new_cap * sizeof(StatReq));
+            size_t *idx = realloc(p->idx, new_cap * sizeof(size_t));
+            if (!reqs || !idx) die("realloc");
+            p->reqs = reqs;
+            p->idx = idx;
+            p->cap = new_cap;
+        }
+        p->reqs[p->n].name = e->name;
+        p->idx[p->n++] = *cnt;
+    }
+    (*cnt)++;
+}
 
-    e->name = strdup(name);
-    if (!e->name) die("strdup");
+// Прочитанный и отсортированный каталог
+typedef struct {
+    Entry *entries;
+    size_t cnt;
+    Arena arena;
+} Listing;
 
-    // формируем fullpath = dirpath + '/' + name
-    size_t len_dir = strlen(dirpath);
-    int need_slash = (len_dir > 0 && dirpath[len_dir - 1] != '/');
+// Читает открытый каталог dir (path — для сообщений); ошибки stat — в err
+static void read_listing(DIR *dir, const char *path, const Opts *o, Listing *ls, FILE *err) {
+    Entry *entries = NULL;
+    size_t cnt = 0, cap = 0;
+    arena_init(&ls->arena);
 
-    size_t full_len = len_dir + (need_slash ? 1 : 0) + strlen(name) + 1;
-    e->fullpath = malloc(full_len);
-    if (!e->fullpath) die("malloc");
+    // stat и readlink — относительно открытого каталога, без сборки полного пути;
+    // statx уходят пакетами по STAT_BATCH записей, пока readdir читает дальше
+    int dfd = dirfd(dir);
+    Pending pend = { 0 };
+    size_t failed = 0;
 
-    strcpy(e->fullpath, dirpath);
-    if (need_slash) strcat(e->fullpath, "/");
-    strcat(e->fullpath, name);
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        const char *name = de->d_name;
+        if (!o->all) {
+            if (name[0] == '.') continue; // скрытые не показываем
+        }
+        add_entry(&entries, &cnt, &cap, &ls->arena, &pend, de, o);
+        if (pend.n == STAT_BATCH) failed += flush_pending(&pend, entries, &ls->arena, dfd, path, o, err);
+    }
+    if (pend.n > 0) failed += flush_pending(&pend, entries, &ls->arena, dfd, path, o, err);
 
-    struct stat stbuf;
-    if (lstat(e->fullpath, &stbuf) == -1) {
-        fprintf(stderr, "myls: cannot stat '%s': %s\n", e->fullpath, strerror(errno));
-        free(e->name);
-        free(e->fullpath);
-        return; // просто пропускаем, не увеличиваем *cnt
+    free(pend.reqs);
+    free(pend.idx);
+
+    // выбрасываем записи, которые не удалось stat'нуть
+    if (failed > 0) {
+        size_t k = 0;
+        for (size_t i = 0; i < cnt; ++i) {
+            if (entries[i].name) entries[k++] = entries[i];
+        }
+        cnt = k;
     }
 
-    e->st = stbuf;
-    e->is_symlink = S_ISLNK(stbuf.st_mode);
-    e->link_len = 0;
+    if (cnt > 1 && !o->unsorted) qsort(entries, cnt, sizeof(Entry), cmp_entries);
+    ls->entries = entries;
+    ls->cnt = cnt;
+}
 
-    if (e->is_symlink) {
-        ssize_t r = readlink(e->fullpath, e->link_target, sizeof(e->link_target) - 1);
-        if (r >= 0) {
-            e->link_target[r] = '\0';
-            e->link_len = r;
+static void print_listing(FILE *out, const Listing *ls, const Opts *o) {
+    if (o->longfmt) {
+        Widths w;
+        compute_widths(ls->entries, ls->cnt, &w, o);
+        fprintf(out, "total %lld\n", w.total_blocks);
+        for (size_t i = 0; i < ls->cnt; ++i) {
+            print_entry_long(out, &ls->entries[i], &w, o);
+        }
+    } else {
+        for (size_t i = 0; i < ls->cnt; ++i) {
+            print_entry_short(out, &ls->entries[i], o);
         }
     }
+}
 
-    (*cnt)++;
+static void free_listing(Listing *ls) {
+    free(ls->entries);
+    arena_free(&ls->arena);
+}
+
+static void stream_entry(Writer *w, const Entry *e, const Opts *o) {
+    const char *color = color_for_entry(e, o);
+    if (color) writer_put(w, color, strlen(color));
+    writer_put(w, e->name, strlen(e->name));
+    if (color) writer_put(w, COLOR_RESET, sizeof(COLOR_RESET) - 1);
+    writer_put(w, "\n", 1);
 }
 
-static void list_directory(const char *path, bool flag_a, bool flag_l, bool print_header, bool multiple) {
+// Короткий листинг без сортировки: каждая порция getdents64 сразу уходит в
+// вывод, имена берутся прямо из её буфера. Память не зависит от размера
+// каталога, первые строки появляются после первой порции.
+static void stream_directory(int fd, const char *path, const Opts *o) {
+    char *buf = malloc(STREAM_BUF);
+    Writer w;
+    if (!buf || writer_init(&w, STDOUT_FILENO, STREAM_BUF) < 0) die("malloc");
+
+    Entry *entries = NULL;
+    size_t cap = 0;
+    Pending pend = { 0 };
+    Arena arena;        // flush_pending кладёт в неё только поля -l, здесь их нет
+    arena_init(&arena);
+
+    for (;;) {
+        ssize_t nread = getdents64(fd, buf, STREAM_BUF);
+        if (nread < 0 && errno == EINTR) continue;
+        if (nread < 0) {
+            fprintf(stderr, "myls: reading directory '%s': %s\n", path, strerror(errno));
+            break;
+        }
+        if (nread == 0) break;
+
+        size_t cnt = 0;
+        for (ssize_t off = 0; off < nread;) {
+            const struct dirent64 *de = (const struct dirent64 *)(buf + off);
+            off += de->d_reclen;
+            if (!o->all && de->d_name[0] == '.') continue;
+
+            if (cnt == cap) {
+                cap = cap ? cap * 2 : 1024;
+                Entry *tmp = realloc(entries, cap * sizeof(Entry));
+                if (!tmp) die("realloc");
+                entries = tmp;
+            }
+            Entry *e = &entries[cnt];
+            e->name = de->d_name;
+            e->mode = DTTOIF(de->d_type);
+            e->lng = NULL;
+
+            // цвет: тип из d_type, stat — только обычным файлам и DT_UNKNOWN
+            if (need_stat(de->d_type, o)) {
+                if (pend.n == pend.cap) {
+                    pend.cap = pend.cap ? pend.cap * 2 : 1024;
+                    pend.reqs = realloc(pend.reqs, pend.cap * sizeof(StatReq));
+                    pend.idx = realloc(pend.idx, pend.cap * sizeof(size_t));
+                    if (!pend.reqs || !pend.idx) die("realloc");
+                }
+                pend.reqs[pend.n].name = e->name;
+                pend.idx[pend.n++] = cnt;
+            }
+            cnt++;
+        }
+        if (pend.n > 0) flush_pending(&pend, entries, &arena, fd, path, o, stderr);
+
+        for (size_t i = 0; i < cnt; ++i) {
+            if (entries[i].name) stream_entry(&w, &entries[i], o);
+        }
+        writer_flush(&w);
+        if (w.failed) {
+            fprintf(stderr, "myls: write error: %s\n", strerror(w.err));
+            break;
+        }
+    }
+
+    free(entries);
+    free(pend.reqs);
+    free(pend.idx);
+    arena_free(&arena);
+    writer_free(&w);
+    free(buf);
+}
+
+static void list_directory(const char *path, const Opts *o, bool print_header, bool multiple) {
+    // -U без -l: ни сортировки, ни ширин колонок — выводим по мере чтения
+    if (o->unsorted && !o->longfmt) {
+        int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) {
+            fprintf(stderr, "myls: cannot open directory '%s': %s\n", path, strerror(errno));
+            return;
+        }
+        if (print_header && multiple) {
+            printf("%s:\n", path);
+        }
+        fflush(stdout);     // дальше пишем мимо stdio
+        stream_directory(fd, path, o);
+        close(fd);
+        if (multiple) {
+            putchar('\n');
+        }
+        return;
+    }
+
     DIR *dir = opendir(path);
     if (!dir) {
         fprintf(stderr, "myls: cannot open directory '%s': %s\n", path, strerror(errno));
@@ -265,90 +495,322 @@ static void list_directory(const char *path, bool flag_a, bool flag_l, bool prin
         printf("%s:\n", path);
     }
 
-    Entry *entries = NULL;
-    size_t cnt = 0, cap = 0;
+    Listing ls;
+    read_listing(dir, path, o, &ls, stderr);
+    closedir(dir);
+    print_listing(stdout, &ls, o);
+    free_listing(&ls);
 
-    struct dirent *de;
-    while ((de = readdir(dir)) != NULL) {
-        const char *name = de->d_name;
-        if (!flag_a) {
-            if (name[0] == '.') continue; // скрытые не показываем
-        }
-        add_entry(&entries, &cnt, &cap, path, name);
+    if (multiple) {
+        putchar('\n');
     }
+}
 
-    closedir(dir);
-
-    qsort(entries, cnt, sizeof(Entry), cmp_entries);
+// ---------- -R: параллельный обход ----------
+//
+// Каждый каталог — узел. Рабочие потоки пула (очередь на поток, простаивающие
+// воруют из чужих) читают каталоги в собственные буферы вывода и ставят
+// подкаталоги в очередь; fd каталога остаётся открытым, пока все дети не
+// откроют себя через openat. Главный поток выводит узлы строго в порядке
+// обхода в глубину по отсортированным именам, а узел, до которого рабочие ещё
+// не добрались, обрабатывает сам. Поэтому рабочие могут перестать брать новые
+// каталоги, когда готового вывода набралось REC_BUF_LIMIT, и память на широких
+// деревьях ограничена, а вывод не зависит от числа потоков.
+
+// fd каталога для openat его детей; закрывает последний из них
+typedef struct {
+    int fd;                 // -1 — не хватило fd, дети открываются по пути
+    size_t users;
+} DirFd;
+
+enum { R_QUEUED, R_RUNNING, R_DONE };
+
+typedef struct RNode {
+    char *path;             // для заголовка, сообщений и запасного open
+    const char *name;       // последний компонент path
+    DirFd *parent;          // NULL у корня и после открытия
+    int state;              // R_* (под mu)
+    int refs;               // выдача и задача пула (под mu)
+    char *out, *err;        // готовый вывод и сообщения об ошибках
+    size_t out_len, err_len;
+    struct RNode **kids;    // подкаталоги в порядке вывода
+    size_t n_kids;
+} RNode;
+
+// IdCache и StatBatch не потокобезопасны: у каждого рабочего свои
+typedef struct WorkerState {
+    struct WorkerState *next;
+    IdCache ids;
+    StatBatch *stats;
+} WorkerState;
 
-    if (flag_l) {
-        Widths w;
-        compute_widths(entries, cnt, &w);
-        printf("total %lld\n", w.total_blocks);
-        for (size_t i = 0; i < cnt; ++i) {
-            print_entry_long(&entries[i], &w);
-        }
+typedef struct {
+    const Opts *o;
+    Pool *pool;             // NULL — обход в одном потоке
+    pthread_mutex_t mu;
+    pthread_cond_t cv;      // узел готов или освободился бюджет
+    size_t buffered;        // байт готового, но не выведенного вывода
+    WorkerState *states;
+} RecCtx;
+
+static _Thread_local WorkerState *tls_state;
+
+static RNode *rnode_new(const char *dir, const char *name, DirFd *parent, int refs) {
+    RNode *n = calloc(1, sizeof(*n));
+    if (!n) die("malloc");
+    if (dir) {
+        size_t ld = strlen(dir);
+        bool slash = ld > 0 && dir[ld - 1] != '/';
+        n->path = malloc(ld + slash + strlen(name) + 1);
+        if (!n->path) die("malloc");
+        memcpy(n->path, dir, ld);
+        if (slash) n->path[ld] = '/';
+        strcpy(n->path + ld + slash, name);
+        n->name = n->path + ld + slash;
     } else {
-        for (size_t i = 0; i < cnt; ++i) {
-            print_entry_short(&entries[i]);
-        }
+        n->path = strdup(name);
+        if (!n->path) die("malloc");
+        n->name = n->path;
     }
+    n->parent = parent;
+    n->state = R_QUEUED;
+    n->refs = refs;
+    return n;
+}
 
-    free_entries(entries, cnt);
+static void rnode_unref(RecCtx *c, RNode *n) {
+    pthread_mutex_lock(&c->mu);
+    bool last = --n->refs == 0;
+    pthread_mutex_unlock(&c->mu);
+    if (!last) return;
+    free(n->out);
+    free(n->err);
+    free(n->kids);
+    free(n->path);
+    free(n);
+}
 
-    if (multiple) {
-        putchar('\n');
+// Открыть каталог n относительно родителя и отпустить fd родителя
+static int rec_open(RecCtx *c, RNode *n) {
+    int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+    DirFd *p = n->parent;
+    if (!p) return open(n->path, flags);
+
+    int fd = p->fd >= 0 ? openat(p->fd, n->name, flags) : open(n->path, flags);
+    int saved = errno;
+
+    pthread_mutex_lock(&c->mu);
+    bool last = --p->users == 0;
+    pthread_mutex_unlock(&c->mu);
+    if (last) {
+        if (p->fd >= 0) close(p->fd);
+        free(p);
     }
+    n->parent = NULL;
+    errno = saved;
+    return fd;
 }
 
-static void print_single_path(const char *path, bool flag_l) {
-    Entry e;
-    memset(&e, 0, sizeof(e));
+// Подкаталоги листинга — дети n; ссылки не раскрываем, "." и ".." пропускаем
+static void rec_add_kids(RecCtx *c, RNode *n, const Listing *ls, int dfd) {
+    size_t k = 0;
+    for (size_t i = 0; i < ls->cnt; ++i) {
+        const char *name = ls->entries[i].name;
+        if (!S_ISDIR(ls->entries[i].mode)) continue;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+        k++;
+    }
+    if (k == 0) return;
+
+    DirFd *p = malloc(sizeof(*p));
+    n->kids = malloc(k * sizeof(*n->kids));
+    if (!p || !n->kids) die("malloc");
+    p->fd = fcntl(dfd, F_DUPFD_CLOEXEC, 0);
+    p->users = k;
+
+    for (size_t i = 0; i < ls->cnt; ++i) {
+        const char *name = ls->entries[i].name;
+        if (!S_ISDIR(ls->entries[i].mode)) continue;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+        n->kids[n->n_kids++] = rnode_new(n->path, name, p, c->pool ? 2 : 1);
+    }
+}
 
-    e.name = strdup(path);
-    if (!e.name) die("strdup");
+// Листинг каталога n в его буферы; дети — в очередь пула
+static void rec_process(RecCtx *c, RNode *n, const Opts *o) {
+    FILE *out = open_memstream(&n->out, &n->out_len);
+    FILE *err = open_memstream(&n->err, &n->err_len);
+    if (!out || !err) die("open_memstream");
 
-    e.fullpath = strdup(path);
-    if (!e.fullpath) die("strdup");
+    int fd = rec_open(c, n);
+    DIR *dir = fd >= 0 ? fdopendir(fd) : NULL;
+    if (!dir) {
+        fprintf(err, "myls: cannot open directory '%s': %s\n", n->path, strerror(errno));
+        if (fd >= 0) close(fd);
+    } else {
+        Listing ls;
+        read_listing(dir, n->path, o, &ls, err);
+        fprintf(out, "%s:\n", n->path);
+        print_listing(out, &ls, o);
+        fputc('\n', out);
+        rec_add_kids(c, n, &ls, fd);
+        closedir(dir);
+        free_listing(&ls);
+    }
+    if (fclose(out) != 0 || fclose(err) != 0) die("open_memstream");
 
-    if (lstat(path, &e.st) == -1) {
-        fprintf(stderr, "myls: cannot access '%s': %s\n", path, strerror(errno));
-        free(e.name);
-        free(e.fullpath);
-        return;
+    pthread_mutex_lock(&c->mu);
+    n->state = R_DONE;
+    c->buffered += n->out_len + n->err_len;
+    pthread_cond_broadcast(&c->cv);
+    pthread_mutex_unlock(&c->mu);
+
+    // узел жив: вызывающий держит на него ссылку
+    if (c->pool) {
+        for (size_t i = 0; i < n->n_kids; ++i) pool_submit(c->pool, (size_t)(uintptr_t)n->kids[i]);
     }
+}
 
-    e.is_symlink = S_ISLNK(e.st.st_mode);
-    if (e.is_symlink) {
-        ssize_t r = readlink(path, e.link_target, sizeof(e.link_target) - 1);
-        if (r >= 0) {
-            e.link_target[r] = '\0';
-            e.link_len = r;
+static void ids_init(IdCache *ids) {
+    idcache_init(ids);
+    const char *preload = getenv("MYLS_PRELOAD_IDS");
+    if (preload && strcmp(preload, "1") == 0) idcache_preload(ids);
+}
+
+static WorkerState *worker_state(RecCtx *c) {
+    if (tls_state) return tls_state;
+    WorkerState *ws = calloc(1, sizeof(*ws));
+    if (!ws) die("malloc");
+    if (c->o->ids) ids_init(&ws->ids);
+    if (c->o->stats && !(ws->stats = statbatch_create())) die("malloc");
+
+    pthread_mutex_lock(&c->mu);
+    ws->next = c->states;
+    c->states = ws;
+    pthread_mutex_unlock(&c->mu);
+    return tls_state = ws;
+}
+
+static void rec_task(void *arg, size_t task) {
+    RecCtx *c = arg;
+    RNode *n = (RNode *)(uintptr_t)task;
+
+    // не убегаем далеко вперёд выдачи; узел, который ей нужен, она возьмёт сама
+    pthread_mutex_lock(&c->mu);
+    while (n->state == R_QUEUED && c->buffered >= REC_BUF_LIMIT) pthread_cond_wait(&c->cv, &c->mu);
+    bool mine = n->state == R_QUEUED;
+    if (mine) n->state = R_RUNNING;
+    pthread_mutex_unlock(&c->mu);
+
+    if (mine) {
+        WorkerState *ws = worker_state(c);
+        Opts lo = *c->o;
+        if (lo.ids) lo.ids = &ws->ids;
+        lo.stats = ws->stats;
+        rec_process(c, n, &lo);
+    }
+    rnode_unref(c, n);
+}
+
+static void list_recursive(const char *path, const Opts *o) {
+    RecCtx c = { .o = o };
+    pthread_mutex_init(&c.mu, NULL);
+    pthread_cond_init(&c.cv, NULL);
+    if (o->jobs > 1) c.pool = pool_create(o->jobs, rec_task, &c);
+
+    // стек ещё не выведенных узлов: вершина — следующий по порядку
+    size_t sp = 0, scap = 16;
+    RNode **stack = malloc(scap * sizeof(*stack));
+    if (!stack) die("malloc");
+    stack[sp++] = rnode_new(NULL, path, NULL, 1);
+
+    while (sp > 0) {
+        RNode *n = stack[--sp];
+
+        pthread_mutex_lock(&c.mu);
+        bool mine = n->state == R_QUEUED;
+        if (mine) n->state = R_RUNNING;
+        pthread_mutex_unlock(&c.mu);
+        if (mine) rec_process(&c, n, o);
+
+        pthread_mutex_lock(&c.mu);
+        while (n->state != R_DONE) pthread_cond_wait(&c.cv, &c.mu);
+        pthread_mutex_unlock(&c.mu);
+
+        fwrite(n->out, 1, n->out_len, stdout);
+        fwrite(n->err, 1, n->err_len, stderr);
+        free(n->out);
+        free(n->err);
+        n->out = n->err = NULL;
+
+        pthread_mutex_lock(&c.mu);
+        c.buffered -= n->out_len + n->err_len;
+        pthread_cond_broadcast(&c.cv);
+        pthread_mutex_unlock(&c.mu);
+
+        if (sp + n->n_kids > scap) {
+            while (sp + n->n_kids > scap) scap *= 2;
+            RNode **tmp = realloc(stack, scap * sizeof(*stack));
+            if (!tmp) die("realloc");
+            stack = tmp;
         }
+        for (size_t i = n->n_kids; i > 0; --i) stack[sp++] = n->kids[i - 1];
+        rnode_unref(&c, n);
     }
 
-    if (flag_l) {
+    if (c.pool) {
+        pool_wait(c.pool);
+        pool_destroy(c.pool);
+    }
+    while (c.states) {
+        WorkerState *ws = c.states;
+        c.states = ws->next;
+        if (o->ids) idcache_free(&ws->ids);
+        if (ws->stats) statbatch_destroy(ws->stats);
+        free(ws);
+    }
+    free(stack);
+    pthread_mutex_destroy(&c.mu);
+    pthread_cond_destroy(&c.cv);
+}
+
+// mode — уже известный из lstat в main тип файла
+static void print_single_path(const char *path, mode_t mode, const Opts *o) {
+    Entry e;
+    Arena arena;
+    arena_init(&arena);
+
+    if (fill_entry(&e, &arena, AT_FDCWD, path, IFTODT(mode), o) == -1) {
+        fprintf(stderr, "myls: cannot access '%s': %s\n", path, strerror(errno));
+        arena_free(&arena);
+        return;
+    }
+
+    if (o->longfmt) {
         Widths w;
-        compute_widths(&e, 1, &w);
-        print_entry_long(&e, &w);
+        compute_widths(&e, 1, &w, o);
+        print_entry_long(stdout, &e, &w, o);
     } else {
-        print_entry_short(&e);
+        print_entry_short(stdout, &e, o);
     }
 
-    free(e.name);
-    free(e.fullpath);
+    arena_free(&arena);
 }
 
 static void usage(const char *prog) {
-    fprintf(stderr, "Usage: %s [-l] [-a] [FILE...]\n", prog);
+    fprintf(stderr, "Usage: %s [-l] [-a] [-R] [-U] [-f] [-j N] [FILE...]\n", prog);
 }
 
 int main(int argc, char **argv) {
     bool flag_l = false;
     bool flag_a = false;
+    bool flag_R = false;
+    bool flag_U = false;
+    bool flag_f = false;
+    int jobs = 0;
 
     int opt;
-    while ((opt = getopt(argc, argv, "la")) != -1) {
+    while ((opt = getopt(argc, argv, "laRUfj:")) != -1) {
         switch (opt) {
             case 'l':
                 flag_l = true;
@@ -356,19 +818,64 @@ int main(int argc, char **argv) {
             case 'a':
                 flag_a = true;
                 break;
+            case 'R':
+                flag_R = true;
+                break;
+            case 'U':
+                flag_U = true;
+                break;
+            case 'f':
+                // как в GNU ls: -aU, без -l и цвета (более поздний -l снова включает)
+                flag_f = flag_U = flag_a = true;
+                flag_l = false;
+                break;
+            case 'j': {
+                char *endp;
+                long v = strtol(optarg, &endp, 10);
+                if (*endp != '\0' || v < 1 || v > 1024) {
+                    fprintf(stderr, "myls: invalid number of jobs '%s'\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                jobs = (int)v;
+                break;
+            }
             default:
                 usage(argv[0]);
                 return EXIT_FAILURE;
         }
     }
 
+    // цвета — только на терминал, иначе без stat для коротких листингов
+    Opts o = { .all = flag_a, .longfmt = flag_l, .color = !flag_f && isatty(STDOUT_FILENO),
+               .recursive = flag_R, .unsorted = flag_U, .jobs = jobs };
+
+    // по умолчанию -R обходит в стольких потоках, сколько процессоров
+    if (o.jobs == 0) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        o.jobs = ncpu < 1 ? 1 : ncpu > REC_MAX_JOBS ? REC_MAX_JOBS : (int)ncpu;
+    }
+
+    // uid/gid -> имя: один кэш на весь запуск (и по одному на рабочий поток -R);
+    // MYLS_PRELOAD_IDS=1 — сразу прочитать /etc/passwd и /etc/group вместо
+    // поштучных запросов к NSS
+    IdCache ids;
+    if (flag_l) {
+        ids_init(&ids);
+        o.ids = &ids;
+    }
+
+    if (flag_l || o.color || flag_R) {
+        o.stats = statbatch_create();
+        if (!o.stats) die("malloc");
+    }
+
     int n_paths = argc - optind;
     char **paths = argv + optind;
 
     if (n_paths == 0) {
         // по умолчанию — текущий каталог
-        list_directory(".", flag_a, flag_l, false, false);
-        return 0;
+        if (flag_R) list_recursive(".", &o);
+        else list_directory(".", &o, false, false);
     }
 
     // Определим, много ли каталогов/путей
@@ -383,13 +890,17 @@ int main(int argc, char **argv) {
             continue;
         }
 
-        if (S_ISDIR(st.st_mode)) {
-            list_directory(p, flag_a, flag_l, true, multiple);
+        if (S_ISDIR(st.st_mode) && flag_R) {
+            list_recursive(p, &o);
+        } else if (S_ISDIR(st.st_mode)) {
+            list_directory(p, &o, true, multiple);
         } else {
             // обычный файл/ссылка
-            print_single_path(p, flag_l);
+            print_single_path(p, st.st_mode, &o);
         }
     }
 
+    if (flag_l) idcache_free(&ids);
+    if (o.stats) statbatch_destroy(o.stats);
     return 0;
 }
@@ -0,0 +1,284 @@
+#define _GNU_SOURCE
+
+#include "statbatch.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "uring.h"
+
+#define STAT_BATCH_MIN      16      // пакеты меньше — синхронно, по одному
+#define STAT_PROBE          16      // начало пакета — синхронно, с замером времени
+#define STAT_SLOW_NS        10000   // медленнее: кэш холодный или ФС сетевая — остальное пакетом
+#define STAT_DEPTH_DEFAULT  128     // запросов в полёте
+#define STAT_DEPTH_MAX      4096
+#define STAT_MAX_THREADS    32
+#define STAT_CLAIM          4       // столько запросов поток берёт за раз
+
+#define STAT_FLAGS  (AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT)
+
+typedef enum { MODE_SYNC, MODE_THREADS, MODE_URING } Mode;
+
+struct StatBatch {
+    Mode mode;
+    unsigned depth;
+    bool started;           // кольцо или потоки уже заведены
+    bool slow;              // stat уже оказывался медленным: замер больше не нужен
+
+    Ring ring;
+
+    pthread_t threads[STAT_MAX_THREADS];
+    int n_threads;
+    pthread_mutex_t mu;
+    pthread_cond_t cv_work, cv_done;
+    unsigned long gen;      // номер пакета: рабочие ждут, пока он сменится
+    bool stop;
+
+    // текущий пакет (для потоков — под mu)
+    int dirfd;
+    unsigned mask;
+    StatReq *reqs;
+    size_t n, next, done;
+};
+
+int stat_at(int dirfd, const char *name, unsigned mask, struct statx *stx) {
+    static atomic_bool no_statx;    // зовётся из нескольких потоков (-R)
+    if (!atomic_load_explicit(&no_statx, memory_order_relaxed)) {
+        if (statx(dirfd, name, STAT_FLAGS, mask, stx) == 0) return 0;
+        if (errno != ENOSYS) return -1;
+        atomic_store_explicit(&no_statx, true, memory_order_relaxed);
+    }
+    struct stat st;
+    if (fstatat(dirfd, name, &st, AT_SYMLINK_NOFOLLOW) == -1) return -1;
+    stx->stx_mode = (__u16)st.st_mode;
+    stx->stx_nlink = (__u32)st.st_nlink;
+    stx->stx_uid = st.st_uid;
+    stx->stx_gid = st.st_gid;
+    stx->stx_size = (__u64)st.st_size;
+    stx->stx_blocks = (__u64)st.st_blocks;
+    stx->stx_mtime.tv_sec = st.st_mtime;
+    return 0;
+}
+
+static void stat_req(int dirfd, unsigned mask, StatReq *r) {
+    r->err = stat_at(dirfd, r->name, mask, &r->stx) == 0 ? 0 : errno;
+}
+
+static void run_sync(int dirfd, unsigned mask, StatReq *reqs, size_t n) {
+    for (size_t i = 0; i < n; ++i) stat_req(dirfd, mask, &reqs[i]);
+}
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// ---------- io_uring ----------
+
+typedef struct {
+    StatBatch *b;
+    bool unsupported;       // ядро не знает IORING_OP_STATX
+} UringCtx;
+
+static void uring_done(void *ctx, const struct io_uring_cqe *cqe) {
+    UringCtx *c = ctx;
+    StatReq *r = &c->b->reqs[cqe->user_data];
+    if (cqe->res == -EINVAL) {
+        // флаги и маска корректны, значит сама операция не поддерживается
+        c->unsupported = true;
+        stat_req(c->b->dirfd, c->b->mask, r);
+    } else {
+        r->err = cqe->res < 0 ? -cqe->res : 0;
+    }
+}
+
+// Держит в полёте до depth запросов, пока не выполнит все.
+// false — кольцо отказало или операция не поддерживается: дальше без io_uring.
+static bool run_uring(StatBatch *b) {
+    UringCtx ctx = { .b = b };
+    bool ok = true;
+    for (size_t i = 0; i < b->n; ++i) b->reqs[i].err = -1;
+
+    while (b->next < b->n || b->ring.inflight > 0) {
+        while (b->next < b->n && b->ring.inflight < b->depth) {
+            StatReq *r = &b->reqs[b->next];
+            struct io_uring_sqe *sqe = ring_sqe(&b->ring, b->next++);
+            sqe->opcode = IORING_OP_STATX;
+            sqe->fd = b->dirfd;
+            sqe->addr = (uint64_t)(uintptr_t)r->name;
+            sqe->len = b->mask;
+            sqe->off = (uint64_t)(uintptr_t)&r->stx;
+            sqe->statx_flags = STAT_FLAGS;
+        }
+        if (ring_pump(&b->ring, uring_done, &ctx) < 0) {
+            // отправленные statx ещё пишут в reqs[i].stx: сначала дождаться их
+            ring_drain(&b->ring, uring_done, &ctx);
+            ok = false;
+            break;
+        }
+    }
+
+    // недоделанное — синхронно
+    for (size_t i = 0; i < b->n; ++i) {
+        if (b->reqs[i].err == -1) stat_req(b->dirfd, b->mask, &b->reqs[i]);
+    }
+    return ok && !ctx.unsupported;
+}
+
+// ---------- пул потоков ----------
+
+// Разбирает запросы текущего пакета порциями по STAT_CLAIM; вызывается под mu
+static void run_share(StatBatch *b) {
+    while (b->next < b->n) {
+        size_t i = b->next;
+        size_t end = b->n - i > STAT_CLAIM ? i + STAT_CLAIM : b->n;
+        b->next = end;
+        int dirfd = b->dirfd;
+        unsigned mask = b->mask;
+        StatReq *reqs = b->reqs;
+        pthread_mutex_unlock(&b->mu);
+
+        for (size_t k = i; k < end; ++k) stat_req(dirfd, mask, &reqs[k]);
+
+        pthread_mutex_lock(&b->mu);
+        b->done += end - i;
+        if (b->done == b->n) pthread_cond_broadcast(&b->cv_done);
+    }
+}
+
+static void *stat_worker(void *arg) {
+    StatBatch *b = arg;
+    unsigned long seen = 0;
+    pthread_mutex_lock(&b->mu);
+    for (;;) {
+        while (!b->stop && b->gen == seen) pthread_cond_wait(&b->cv_work, &b->mu);
+        if (b->stop) break;
+        seen = b->gen;
+        run_share(b);
+    }
+    pthread_mutex_unlock(&b->mu);
+    return NULL;
+}
+
+static void run_threads(StatBatch *b, int dirfd, unsigned mask, StatReq *reqs, size_t n) {
+    pthread_mutex_lock(&b->mu);
+    b->dirfd = dirfd;
+    b->mask = mask;
+    b->reqs = reqs;
+    b->n = n;
+    b->next = b->done = 0;
+    b->gen++;
+    pthread_cond_broadcast(&b->cv_work);
+    run_share(b);   // вызывающий поток тоже работает
+    while (b->done < b->n) pthread_cond_wait(&b->cv_done, &b->mu);
+    pthread_mutex_unlock(&b->mu);
+}
+
+static void start_threads(StatBatch *b) {
+    pthread_mutex_init(&b->mu, NULL);
+    pthread_cond_init(&b->cv_work, NULL);
+    pthread_cond_init(&b->cv_done, NULL);
+    int want = b->depth - 1 < STAT_MAX_THREADS ? (int)b->depth - 1 : STAT_MAX_THREADS;
+    for (; b->n_threads < want; ++b->n_threads) {
+        if (pthread_create(&b->threads[b->n_threads], NULL, stat_worker, b) != 0) break;
+    }
+    if (b->n_threads > 0) return;
+
+    pthread_mutex_destroy(&b->mu);
+    pthread_cond_destroy(&b->cv_work);
+    pthread_cond_destroy(&b->cv_done);
+    b->mode = MODE_SYNC;
+}
+
+// ---------- интерфейс ----------
+
+StatBatch *statbatch_create(void) {
+    StatBatch *b = calloc(1, sizeof(*b));
+    if (!b) return NULL;
+
+    const char *mode = getenv("MYLS_STAT");    // sync | threads | (по умолчанию) uring
+    if (mode && strcmp(mode, "sync") == 0) b->mode = MODE_SYNC;
+    else if (mode && strcmp(mode, "threads") == 0) b->mode = MODE_THREADS;
+    else b->mode = MODE_URING;
+
+    b->depth = STAT_DEPTH_DEFAULT;
+    const char *depth = getenv("MYLS_STAT_DEPTH");
+    if (depth) {
+        long d = atol(depth);
+        if (d >= 1 && d <= STAT_DEPTH_MAX) b->depth = (unsigned)d;
+    }
+    if (b->depth == 1) b->mode = MODE_SYNC;
+    return b;
+}
+
+void statbatch_run(StatBatch *b, int dirfd, unsigned mask, StatReq *reqs, size_t n) {
+    if (n < STAT_BATCH_MIN || b->mode == MODE_SYNC) {
+        run_sync(dirfd, mask, reqs, n);
+        return;
+    }
+
+    // С тёплым кэшем statx стоит микросекунду, и очередь только мешает.
+    // Пакетом — только если первые запросы ждали устройство или сеть.
+    if (!b->slow) {
+        long long t0 = now_ns();
+        run_sync(dirfd, mask, reqs, STAT_PROBE);
+        reqs += STAT_PROBE;
+        n -= STAT_PROBE;
+        if ((now_ns() - t0) / STAT_PROBE < STAT_SLOW_NS) {
+            run_sync(dirfd, mask, reqs, n);
+            return;
+        }
+        b->slow = true;
+        if (n == 0) return;
+    }
+
+    if (!b->started) {
+        b->started = true;
+        if (b->mode == MODE_URING && ring_init(&b->ring, b->depth, 0) < 0) b->mode = MODE_THREADS;
+        if (b->mode == MODE_THREADS) start_threads(b);
+    }
+
+    switch (b->mode) {
+        case MODE_URING:
+            b->dirfd = dirfd;
+            b->mask = mask;
+            b->reqs = reqs;
+            b->n = n;
+            b->next = 0;
+            if (!run_uring(b)) {
+                ring_free(&b->ring);
+                b->mode = MODE_THREADS;
+                start_threads(b);
+            }
+            break;
+        case MODE_THREADS:
+            run_threads(b, dirfd, mask, reqs, n);
+            break;
+        case MODE_SYNC:
+            run_sync(dirfd, mask, reqs, n);
+            break;
+    }
+}
+
+void statbatch_destroy(StatBatch *b) {
+    if (b->started && b->mode == MODE_URING) ring_free(&b->ring);
+    if (b->started && b->mode == MODE_THREADS) {
+        pthread_mutex_lock(&b->mu);
+        b->stop = true;
+        pthread_cond_broadcast(&b->cv_work);
+        pthread_mutex_unlock(&b->mu);
+        for (int i = 0; i < b->n_threads; ++i) pthread_join(b->threads[i], NULL);
+        pthread_mutex_destroy(&b->mu);
+        pthread_cond_destroy(&b->cv_work);
+        pthread_cond_destroy(&b->cv_done);
+    }
+    free(b);
+}
@@ -0,0 +1,34 @@
+#ifndef STATBATCH_H
+#define STATBATCH_H
+
+#include <stddef.h>
+#include <sys/stat.h>
+
+// Пакетный statx для записей одного каталога. Пока одни запросы ждут
+// диска, остальные уже в очереди: через io_uring (IORING_OP_STATX),
+// а где его нет — пулом потоков с обычным statx. В полёте не больше
+// depth запросов. Маленькие пакеты и пакеты, где stat отвечает из кэша
+// (замер по первым запросам), выполняются по одному, синхронно.
+typedef struct StatBatch StatBatch;
+
+typedef struct {
+    const char *name;       // относительно dirfd; живёт до конца statbatch_run
+    struct statx stx;
+    int err;                // 0 или errno
+} StatReq;
+
+// Один statx без перехода по ссылке; без statx в ядре — fstatat.
+// 0 или -1 с errno.
+int stat_at(int dirfd, const char *name, unsigned mask, struct statx *stx);
+
+// Кольцо или потоки заводятся при первом большом пакете.
+// MYLS_STAT=sync|threads|uring (по умолчанию uring), MYLS_STAT_DEPTH=N.
+// NULL — не хватило памяти.
+StatBatch *statbatch_create(void);
+
+// statx(dirfd, name, AT_SYMLINK_NOFOLLOW, mask) для всех n запросов
+void statbatch_run(StatBatch *b, int dirfd, unsigned mask, StatReq *reqs, size_t n);
+
+void statbatch_destroy(StatBatch *b);
+
+#endif
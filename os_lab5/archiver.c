@@ -12,6 +12,8 @@
 #include <time.h>
 #include <unistd.h>
 
+#include "osio.h"
+
 #define MAX_NAME_LEN 255
 #define ARCH_MAGIC "MYARCH1"
 #define ARCH_MAGIC_LEN 7
@@ -44,46 +46,16 @@ static void print_help(const char *prog) {
     printf("  %s myarch.bin -s\n", prog);
 }
 
-static int write_full(int fd, const void *buf, size_t count) {
-    const uint8_t *p = (const uint8_t *)buf;
-    size_t left = count;
-    while (left > 0) {
-        ssize_t n = write(fd, p, left);
-        if (n < 0) {
-            if (errno == EINTR) continue;
-            return -1;
-        }
-        if (n == 0) {
-            errno = EIO;
-            return -1;
-        }
-        p += (size_t)n;
-        left -= (size_t)n;
-    }
-    return 0;
-}
-
 // Возвращает:
 // 0  — прочитали ровно count байт
 // 1  — EOF ДО чтения (0 байт)
 // 2  — "короткое" чтение (EOF посередине) => архив битый
 // -1 — ошибка
 static int read_full_exact(int fd, void *buf, size_t count) {
-    uint8_t *p = (uint8_t *)buf;
-    size_t got = 0;
-
-    while (got < count) {
-        ssize_t n = read(fd, p + got, count - got);
-        if (n < 0) {
-            if (errno == EINTR) continue;
-            return -1;
-        }
-        if (n == 0) {
-            return (got == 0) ? 1 : 2;
-        }
-        got += (size_t)n;
-    }
-    return 0;
+    ssize_t n = read_full(fd, buf, count);
+    if (n < 0) return -1;
+    if (n == 0) return 1;
+    return ((size_t)n < count) ? 2 : 0;
 }
 
 static int open_archive(const char *arch_name, int need_rw, int *fd_out) {
@@ -181,7 +153,6 @@ static int compact_archive_remove(const char *arch_name, int argc_remove, char *
     }
 
     struct FileHeaderDisk hdr;
-    char buf[4096];
 
     while (1) {
         int r = read_full_exact(fd_in, &hdr, sizeof(hdr));
@@ -220,33 +191,21 @@ static int compact_archive_remove(const char *arch_name, int argc_remove, char *
                 unlink(tmp_name);
                 return 1;
             }
-            // копируем данные
-            while (left > 0) {
-                size_t chunk = (left > sizeof(buf)) ? sizeof(buf) : (size_t)left;
-                ssize_t n = read(fd_in, buf, chunk);
-                if (n < 0) {
-                    if (errno == EINTR) continue;
-                    fprintf(stderr, "archiver: read error '%s': %s\n", arch_name, strerror(errno));
-                    close(fd_in);
-                    close(fd_out);
-                    unlink(tmp_name);
-                    return 1;
-                }
-                if (n == 0) {
+            // копируем данные (по возможности внутри ядра)
+            bool read_failed;
+            int rc = copy_range(fd_in, fd_out, left, &read_failed);
+            if (rc != 0) {
+                if (rc == 1) {
                     fprintf(stderr, "archiver: corrupted archive '%s' (truncated data)\n", arch_name);
-                    close(fd_in);
-                    close(fd_out);
-                    unlink(tmp_name);
-                    return 1;
-                }
-                if (write_full(fd_out, buf, (size_t)n) < 0) {
+                } else if (read_failed) {
+                    fprintf(stderr, "archiver: read error '%s': %s\n", arch_name, strerror(errno));
+                } else {
                     fprintf(stderr, "archiver: write error '%s': %s\n", tmp_name, strerror(errno));
-                    close(fd_in);
-                    close(fd_out);
-                    unlink(tmp_name);
-                    return 1;
                 }
-                left -= (uint64_t)n;
+                close(fd_in);
+                close(fd_out);
+                unlink(tmp_name);
+                return 1;
             }
         } else {
             // пропускаем данные
@@ -283,7 +242,6 @@ static int do_input(const char *arch_name, int argc, char **files) {
     }
 
     int exit_code = 0;
-    char buf[4096];
 
     for (int i = 0; i < argc; ++i) {
         const char *path = files[i];
@@ -343,26 +301,17 @@ static int do_input(const char *arch_name, int argc, char **files) {
             break;
         }
 
-        off_t left = st.st_size;
-        while (left > 0) {
-            ssize_t n = read(fd_in, buf, sizeof(buf));
-            if (n < 0) {
-                if (errno == EINTR) continue;
-                fprintf(stderr, "archiver: read error from '%s': %s\n", path, strerror(errno));
-                exit_code = 1;
-                break;
-            }
-            if (n == 0) {
-                fprintf(stderr, "archiver: unexpected EOF on '%s'\n", path);
-                exit_code = 1;
-                break;
-            }
-            if (write_full(fd_arch, buf, (size_t)n) < 0) {
-                fprintf(stderr, "archiver: write error to archive '%s': %s\n", arch_name, strerror(errno));
-                exit_code = 1;
-                break;
-            }
-            left -= (off_t)n;
+        bool read_failed;
+        int r = copy_range(fd_in, fd_arch, (uint64_t)st.st_size, &read_failed);
+        if (r == 1) {
+            fprintf(stderr, "archiver: unexpected EOF on '%s'\n", path);
+            exit_code = 1;
+        } else if (r < 0 && read_failed) {
+            fprintf(stderr, "archiver: read error from '%s': %s\n", path, strerror(errno));
+            exit_code = 1;
+        } else if (r < 0) {
+            fprintf(stderr, "archiver: write error to archive '%s': %s\n", arch_name, strerror(errno));
+            exit_code = 1;
         }
 
         close(fd_in);
@@ -474,29 +423,18 @@ static int extract_one_no_delete(int fd_arch, const char *arch_name, const char
                 return 1;
             }
 
-            char buf[4096];
-            uint64_t left = hdr.size;
-
-            while (left > 0) {
-                size_t chunk = (left > sizeof(buf)) ? sizeof(buf) : (size_t)left;
-                ssize_t n = read(fd_arch, buf, chunk);
-                if (n < 0) {
-                    if (errno == EINTR) continue;
-                    fprintf(stderr, "archiver: read error from archive '%s': %s\n", arch_name, strerror(errno));
-                    close(fd_out);
-                    return 1;
-                }
-                if (n == 0) {
+            bool read_failed;
+            int rc = copy_range(fd_arch, fd_out, hdr.size, &read_failed);
+            if (rc != 0) {
+                if (rc == 1) {
                     fprintf(stderr, "archiver: corrupted archive '%s' (truncated data)\n", arch_name);
-                    close(fd_out);
-                    return 1;
-                }
-                if (write_full(fd_out, buf, (size_t)n) < 0) {
+                } else if (read_failed) {
+                    fprintf(stderr, "archiver: read error from archive '%s': %s\n", arch_name, strerror(errno));
+                } else {
                     fprintf(stderr, "archiver: write error to '%s': %s\n", filename, strerror(errno));
-                    close(fd_out);
-                    return 1;
                 }
-                left -= (uint64_t)n;
+                close(fd_out);
+                return 1;
             }
 
             // восстановление атрибутов
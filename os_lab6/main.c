@@ -11,6 +11,8 @@
 #include <string.h>
 #include <errno.h>
 
+#include "osio.h"
+
 static const char *FIFO_PATH = "./myfifo";
 
 static void format_time(char *buf, size_t sz) {
@@ -87,7 +89,7 @@ static int demo_pipe(void) {
                  "Сообщение от родителя: PID=%d, time=%s",
                  (int)getpid(), time_str);
 
-        if (write(fds[1], msg, strlen(msg)) < 0) {
+        if (write_full(fds[1], msg, strlen(msg)) < 0) {
             perror("[parent] write");
             close(fds[1]);
             return EXIT_FAILURE;
@@ -146,8 +148,7 @@ static int fifo_writer(void) {
              "Сообщение от writer: PID=%d, time=%s",
              (int)getpid(), time_str);
 
-    ssize_t n = write(fd, msg, strlen(msg));
-    if (n < 0) {
+    if (write_full(fd, msg, strlen(msg)) < 0) {
         perror("[writer] write");
         close(fd);
         return EXIT_FAILURE;